@@ -0,0 +1,128 @@
+// 本地限流器的争用基准：多个线程共享同一个限流器实例反复获取令牌，
+// 对比 LocalRateLimiter（互斥锁）与 LocalAtomicRateLimiter（CAS）的吞吐随
+// 线程数的变化
+//
+// 用法：ratelimiter_bench [最大线程数] [每轮时长（毫秒）]
+// 线程数从 1 开始逐次翻倍直到最大线程数（默认 CPU 核数的两倍），每轮默认
+// 1000 毫秒。分两种场景：
+//   unlimited：速率远高于获取速度，令牌永远充足，只测量争用开销
+//   limited：速率为 1000 万每秒，令牌经常耗尽，覆盖获取失败的路径
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "local_atomic_ratelimiter.h"
+#include "local_ratelimiter.h"
+
+namespace {
+
+struct Result {
+    uint64_t calls;      // 调用次数
+    uint64_t granted;    // 获取到的令牌数
+};
+
+template <typename Limiter>
+Result run_round(const std::string& config, std::size_t threads,
+                 std::chrono::milliseconds duration) {
+    auto limiter = std::make_shared<Limiter>();
+    if (!limiter->init(config)) {
+        std::fprintf(stderr, "Failed to init limiter with %s\n",
+                     config.c_str());
+        std::exit(1);
+    }
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> stopped(false);
+    std::atomic<uint64_t> total_calls(0);
+    std::atomic<uint64_t> total_granted(0);
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&] {
+            while (!started.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            uint64_t calls = 0;
+            uint64_t granted = 0;
+            while (!stopped.load(std::memory_order_relaxed)) {
+                granted += limiter->try_acquire(1, nullptr);
+                ++calls;
+            }
+            total_calls += calls;
+            total_granted += granted;
+        });
+    }
+
+    started.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stopped.store(true, std::memory_order_relaxed);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    return Result{total_calls.load(), total_granted.load()};
+}
+
+template <typename Limiter>
+void run_scenario(const char* limiter_name, const char* scenario,
+                  const std::string& config, std::size_t max_threads,
+                  std::chrono::milliseconds duration) {
+    double single_thread_ops = 0.0;
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+        Result result = run_round<Limiter>(config, threads, duration);
+        double seconds = duration.count() / 1000.0;
+        double ops = result.calls / seconds;
+        if (threads == 1) {
+            single_thread_ops = ops;
+        }
+
+        std::printf("%-12s %-10s %4zu %14.0f %14.0f %8.2fx\n", limiter_name,
+                    scenario, threads, ops, result.granted / seconds,
+                    single_thread_ops > 0 ? ops / single_thread_ops : 0.0);
+        std::fflush(stdout);
+    }
+}
+
+}    // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t max_threads =
+        std::max(2u, std::thread::hardware_concurrency() * 2);
+    if (argc > 1) {
+        max_threads = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    std::chrono::milliseconds duration(1000);
+    if (argc > 2) {
+        duration = std::chrono::milliseconds(std::strtol(argv[2], nullptr, 10));
+    }
+
+    if (max_threads == 0 || duration.count() <= 0) {
+        std::fprintf(stderr,
+                     "Usage: %s [max_threads] [round_duration_ms]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string unlimited = R"({"rate": 1e12})";
+    const std::string limited = R"({"rate": 1e7, "burst": 1e5})";
+
+    std::printf("%-12s %-10s %4s %14s %14s %9s\n", "limiter", "scenario",
+                "thr", "calls/s", "granted/s", "scaling");
+    run_scenario<bmq::LocalRateLimiter>("local", "unlimited", unlimited,
+                                        max_threads, duration);
+    run_scenario<bmq::LocalAtomicRateLimiter>(
+        "local_atomic", "unlimited", unlimited, max_threads, duration);
+    run_scenario<bmq::LocalRateLimiter>("local", "limited", limited,
+                                        max_threads, duration);
+    run_scenario<bmq::LocalAtomicRateLimiter>("local_atomic", "limited",
+                                              limited, max_threads, duration);
+    return 0;
+}
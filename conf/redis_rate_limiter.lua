@@ -3,6 +3,8 @@ local capacity = tonumber(ARGV[1])
 local rate = tonumber(ARGV[2])
 local now_ms = tonumber(ARGV[3])
 local key_ttl = tonumber(ARGV[4]) or 3600
+local requested = tonumber(ARGV[5]) or 1
+local returned = tonumber(ARGV[6]) or 0
 
 local bucket = redis.call('HMGET', key, 'tokens', 'last_refill_ms')
 local tokens = tonumber(bucket[1]) or capacity
@@ -16,15 +18,22 @@ if refill_tokens > 0 then
     last_refill_ms = now_ms
 end
 
-local allowed = 0;
-if tokens >= 1 then
-    tokens = tokens - 1
-    allowed = 1
+-- 归还之前授予但未使用的令牌，不超过桶容量
+if returned > 0 then
+    tokens = math.min(capacity, tokens + returned)
+end
+
+-- 按当前可用令牌数部分授予，不足一个令牌时返回下一个令牌的等待时间
+local granted = math.min(requested, math.floor(tokens))
+local wait_ms = 0
+if granted > 0 then
+    tokens = tokens - granted
 else
-    allowed = 0
+    granted = 0
+    wait_ms = math.ceil((1 - tokens) * 1000 / rate)
 end
 
 redis.call('HMSET', key, 'tokens', tokens, 'last_refill_ms', last_refill_ms)
 redis.call('EXPIRE', key, key_ttl)
 
-return allowed
\ No newline at end of file
+return {granted, wait_ms}
\ No newline at end of file
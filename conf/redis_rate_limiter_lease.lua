@@ -0,0 +1,39 @@
+local key = KEYS[1]
+local capacity = tonumber(ARGV[1])
+local rate = tonumber(ARGV[2])
+local now_ms = tonumber(ARGV[3])
+local key_ttl = tonumber(ARGV[4]) or 3600
+local requested = tonumber(ARGV[5]) or 1
+local returned = tonumber(ARGV[6]) or 0
+
+local bucket = redis.call('HMGET', key, 'tokens', 'last_refill_ms')
+local tokens = tonumber(bucket[1]) or capacity
+local last_refill_ms = tonumber(bucket[2]) or now_ms
+
+local elapsed_ms = math.max(0, now_ms - last_refill_ms)
+local refill_tokens = elapsed_ms * rate / 1000
+
+if refill_tokens > 0 then
+    tokens = math.min(capacity, tokens + refill_tokens)
+    last_refill_ms = now_ms
+end
+
+-- 归还上一次租约中未使用的令牌，不超过桶容量
+if returned > 0 then
+    tokens = math.min(capacity, tokens + returned)
+end
+
+-- 按当前可用令牌数租出一批令牌，不足一个令牌时返回下一个令牌的等待时间
+local granted = math.min(requested, math.floor(tokens))
+local wait_ms = 0
+if granted > 0 then
+    tokens = tokens - granted
+else
+    granted = 0
+    wait_ms = math.ceil((1 - tokens) * 1000 / rate)
+end
+
+redis.call('HMSET', key, 'tokens', tokens, 'last_refill_ms', last_refill_ms)
+redis.call('EXPIRE', key, key_ttl)
+
+return {granted, wait_ms}
\ No newline at end of file
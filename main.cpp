@@ -4,6 +4,9 @@
 #include "scheduler_manager.h"
 
 int main(int argc, char* argv[]) {
+    // 解析命令行参数，如 --builtin_port、--limiter_redis_address
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
     if (!bmq::global_init()) {
         SPDLOG_ERROR("Global initialization failed");
         return 1;
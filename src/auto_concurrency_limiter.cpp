@@ -0,0 +1,176 @@
+#include "auto_concurrency_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "nlohmann/json.hpp"
+
+namespace bmq {
+
+// 无负载延迟向窗口最小延迟靠拢的系数，使其能跟随目标的长期变化
+static constexpr double kNoloadDrift = 0.05;
+
+// 单个窗口内上限最多收缩到原来的一半
+static constexpr double kMinGradient = 0.5;
+
+// 名额用完时，尚无延迟估计的等待时间
+static constexpr int64_t kDefaultRetryAfterUs = 10000;
+
+bool AutoConcurrencyLimiter::init(const std::string& config) {
+    try {
+        auto json_config = nlohmann::json::parse(config);
+
+        _min_concurrency = json_config.value("min_concurrency", 1);
+        _max_concurrency = json_config.value("max_concurrency", 1000);
+        std::size_t initial_concurrency =
+            json_config.value("initial_concurrency", 16);
+        _sample_window_us =
+            json_config.value("sample_window_ms", 1000) * 1000LL;
+        _min_samples = json_config.value("min_samples", 20);
+        _tolerance = json_config.value("tolerance", 1.5);
+        _smoothing = json_config.value("smoothing", 0.2);
+        _max_error_rate = json_config.value("max_error_rate", 0.1);
+
+        if (_min_concurrency == 0 || _min_concurrency > _max_concurrency) {
+            SPDLOG_ERROR(
+                "AutoConcurrencyLimiter init failed: min_concurrency must be "
+                "in [1, max_concurrency]");
+            return false;
+        }
+
+        if (_sample_window_us <= 0 || _tolerance < 1.0 || _smoothing <= 0 ||
+            _smoothing > 1.0) {
+            SPDLOG_ERROR(
+                "AutoConcurrencyLimiter init failed: sample_window_ms must be "
+                "positive, tolerance >= 1 and smoothing in (0, 1]");
+            return false;
+        }
+
+        _limit = static_cast<double>(
+            std::min(std::max(initial_concurrency, _min_concurrency),
+                     _max_concurrency));
+        reset_window_locked(now_us());
+        _initialized = true;
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("AutoConcurrencyLimiter init failed: {}", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool AutoConcurrencyLimiter::is_allowed() {
+    return try_acquire(1, nullptr) == 1;
+}
+
+std::size_t AutoConcurrencyLimiter::try_acquire(
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
+    if (!_initialized) {
+        return permits;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::size_t limit = static_cast<std::size_t>(_limit);
+    std::size_t granted =
+        _inflight < limit ? std::min(permits, limit - _inflight) : 0;
+    _inflight += granted;
+    _window_max_inflight = std::max(_window_max_inflight, _inflight);
+
+    // 名额在发送结束时归还，大约等待一次无负载的发送耗时
+    if (granted == 0 && retry_after) {
+        int64_t wait_us = _noload_latency_us > 0
+                              ? static_cast<int64_t>(_noload_latency_us)
+                              : kDefaultRetryAfterUs;
+        *retry_after = std::chrono::milliseconds(
+            std::max<int64_t>(1, (wait_us + 999) / 1000));
+    }
+    return granted;
+}
+
+void AutoConcurrencyLimiter::release(std::size_t permits) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _inflight -= std::min(permits, _inflight);
+}
+
+void AutoConcurrencyLimiter::on_complete(int64_t latency_us, bool success) {
+    if (!_initialized) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    ++_samples;
+    _latency_sum_us += latency_us;
+    if (success) {
+        _window_min_latency_us = std::min(_window_min_latency_us, latency_us);
+    } else {
+        ++_failures;
+    }
+
+    int64_t now = now_us();
+    if (now - _window_start_us < _sample_window_us) {
+        return;
+    }
+
+    // 样本不足时延长窗口继续采样
+    if (_samples >= _min_samples) {
+        update_limit_locked();
+        reset_window_locked(now);
+    }
+}
+
+void AutoConcurrencyLimiter::update_limit_locked() {
+    double error_rate = static_cast<double>(_failures) / _samples;
+    double avg_latency_us = static_cast<double>(_latency_sum_us) / _samples;
+
+    if (_window_min_latency_us != INT64_MAX) {
+        double sample_min = static_cast<double>(_window_min_latency_us);
+        _noload_latency_us =
+            _noload_latency_us < 0 || sample_min < _noload_latency_us
+                ? sample_min
+                : (1 - kNoloadDrift) * _noload_latency_us +
+                      kNoloadDrift * sample_min;
+    }
+
+    double new_limit = _limit;
+    if (error_rate > _max_error_rate || _noload_latency_us <= 0) {
+        // 失败的发送往往很快返回，不能按延迟判断，直接按失败率收缩
+        new_limit = _limit * std::max(kMinGradient, 1 - error_rate);
+    } else {
+        double gradient = std::min(
+            std::max(_tolerance * _noload_latency_us /
+                         std::max(avg_latency_us, 1.0),
+                     kMinGradient),
+            1.0);
+        new_limit = _limit * gradient + std::sqrt(_limit);
+    }
+
+    // 在途数远低于上限时上限并非瓶颈，不再继续上调
+    if (new_limit > _limit && _window_max_inflight < _limit / 2) {
+        new_limit = _limit;
+    }
+
+    // 上调立即生效，下调平滑以免偶发的慢请求使上限骤降
+    double limit = new_limit > _limit
+                       ? new_limit
+                       : (1 - _smoothing) * _limit + _smoothing * new_limit;
+    limit = std::min(std::max(limit, static_cast<double>(_min_concurrency)),
+                     static_cast<double>(_max_concurrency));
+
+    SPDLOG_DEBUG(
+        "Auto concurrency limit {:.1f} -> {:.1f}: avg latency {:.0f}us, "
+        "noload latency {:.0f}us, error rate {:.3f}, {} sample(s)",
+        _limit, limit, avg_latency_us, _noload_latency_us, error_rate,
+        _samples);
+    _limit = limit;
+}
+
+void AutoConcurrencyLimiter::reset_window_locked(int64_t now) {
+    _window_start_us = now;
+    _samples = 0;
+    _failures = 0;
+    _latency_sum_us = 0;
+    _window_min_latency_us = INT64_MAX;
+    _window_max_inflight = _inflight;
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "iratelimiter.h"
+
+namespace bmq {
+
+// 按目标主题发送延迟自适应调整的并发限流器
+//
+// 令牌代表在途发送名额：授予的令牌在消息发送结束后通过 release() 归还，
+// 在途数不超过当前并发上限。每个采样窗口结束时按梯度算法更新上限：
+//   gradient = clamp(tolerance * noload_latency / avg_latency, 0.5, 1)
+//   new_limit = limit * gradient + sqrt(limit)
+// noload_latency 取各窗口最小延迟，缓慢跟随延迟的长期变化。发送延迟
+// 膨胀时 gradient 小于 1，上限收缩；延迟接近无负载延迟时按 sqrt(limit)
+// 逐窗口上调。失败率超过 max_error_rate 时按失败率成比例收缩
+class AutoConcurrencyLimiter : public bmq::IRateLimiter {
+public:
+    AutoConcurrencyLimiter()
+        : _initialized(false),
+          _min_concurrency(1),
+          _max_concurrency(1000),
+          _sample_window_us(1000000),
+          _min_samples(20),
+          _tolerance(1.5),
+          _smoothing(0.2),
+          _max_error_rate(0.1),
+          _limit(16.0),
+          _inflight(0),
+          _noload_latency_us(-1.0),
+          _window_start_us(0),
+          _samples(0),
+          _failures(0),
+          _latency_sum_us(0),
+          _window_min_latency_us(INT64_MAX),
+          _window_max_inflight(0) {}
+
+    bool init(const std::string& config) override;
+
+    bool is_allowed() override;
+
+    std::size_t try_acquire(std::size_t permits,
+                            std::chrono::milliseconds* retry_after) override;
+
+    bool needs_release() const override { return true; }
+
+    void release(std::size_t permits) override;
+
+    void on_complete(int64_t latency_us, bool success) override;
+
+    std::shared_ptr<bmq::IRateLimiter> clone() const override {
+        return std::dynamic_pointer_cast<bmq::IRateLimiter>(
+            std::make_shared<AutoConcurrencyLimiter>());
+    }
+
+private:
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 采样窗口结束时更新并发上限，调用方需持有 _mtx
+    void update_limit_locked();
+
+    void reset_window_locked(int64_t now);
+
+private:
+    std::mutex _mtx;
+    bool _initialized;
+
+    // 配置
+    std::size_t _min_concurrency;
+    std::size_t _max_concurrency;
+    int64_t _sample_window_us;
+    std::size_t _min_samples;      // 窗口内样本数达到该值才更新上限
+    double _tolerance;             // 可容忍的延迟膨胀倍数
+    double _smoothing;             // 下调上限时的平滑系数
+    double _max_error_rate;
+
+    double _limit;              // 当前并发上限
+    std::size_t _inflight;      // 已授予未归还的名额
+    double _noload_latency_us;    // 无负载延迟估计，< 0 表示未知
+
+    // 当前采样窗口
+    int64_t _window_start_us;
+    std::size_t _samples;
+    std::size_t _failures;
+    int64_t _latency_sum_us;
+    int64_t _window_min_latency_us;    // 成功发送的最小延迟
+    std::size_t _window_max_inflight;
+};
+
+}    // namespace bmq
\ No newline at end of file
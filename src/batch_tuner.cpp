@@ -0,0 +1,91 @@
+#include "batch_tuner.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bmq {
+
+// 耗时估计的平滑系数
+static constexpr double kEwmaAlpha = 0.2;
+
+BatchTuner::BatchTuner() : _ms_per_message(-1.0) {}
+
+void BatchTuner::expose(const std::string& prefix) {
+    _batch_size.expose(prefix + "_adaptive_batch_size");
+    _invisible_ms.expose(prefix + "_adaptive_invisible_ms");
+    _ms_per_message_status.expose(prefix + "_adaptive_ms_per_message");
+}
+
+void BatchTuner::configure(const Options& options) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _options = options;
+}
+
+std::size_t BatchTuner::batch_limit(std::size_t fallback) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_options.enable) {
+        return fallback;
+    }
+
+    // 尚无估计时按最大批量拉取，不可见时长相应取上界
+    if (_ms_per_message <= 0) {
+        return _options.max_batch_size;
+    }
+
+    double budget_ms =
+        static_cast<double>(_options.max_invisible_seconds) * 1000 -
+        static_cast<double>(_options.invisible_margin_ms);
+    double limit = std::floor(std::max(budget_ms, 0.0) / _ms_per_message);
+    return static_cast<std::size_t>(
+        std::min(std::max(limit, static_cast<double>(_options.min_batch_size)),
+                 static_cast<double>(_options.max_batch_size)));
+}
+
+std::chrono::milliseconds BatchTuner::invisible_duration(
+    std::size_t batch_size, std::chrono::milliseconds fallback) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (!_options.enable) {
+        return fallback;
+    }
+
+    int64_t min_ms =
+        static_cast<int64_t>(_options.min_invisible_seconds) * 1000;
+    int64_t max_ms =
+        static_cast<int64_t>(_options.max_invisible_seconds) * 1000;
+    int64_t invisible_ms = max_ms;
+    if (_ms_per_message > 0) {
+        double predicted_ms = _ms_per_message * batch_size +
+                              static_cast<double>(_options.invisible_margin_ms);
+        invisible_ms = std::min(
+            std::max(static_cast<int64_t>(std::ceil(predicted_ms)), min_ms),
+            max_ms);
+    }
+    lock.unlock();
+
+    _batch_size.set_value(static_cast<int64_t>(batch_size));
+    _invisible_ms.set_value(invisible_ms);
+    return std::chrono::milliseconds(invisible_ms);
+}
+
+void BatchTuner::record(std::size_t count, int64_t elapsed_us) {
+    if (count == 0 || elapsed_us < 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (!_options.enable) {
+        return;
+    }
+
+    double sample = static_cast<double>(elapsed_us) / 1000 / count;
+    _ms_per_message =
+        _ms_per_message < 0
+            ? sample
+            : kEwmaAlpha * sample + (1 - kEwmaAlpha) * _ms_per_message;
+    double ms_per_message = _ms_per_message;
+    lock.unlock();
+
+    _ms_per_message_status.set_value(ms_per_message);
+}
+
+}    // namespace bmq
\ No newline at end of file
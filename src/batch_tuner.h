@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "bvar/bvar.h"
+
+namespace bmq {
+
+// 拉取批量和不可见时长的自适应控制器
+//
+// 以批次为单位测量拉取完成到本批次全部交给发送（同步模式为全部发送完成）的
+// 耗时，平滑得到单条消息的转发耗时。批量上限取使预测耗时不超过最大不可见
+// 时长的消息数，实际批量再受限流器授予的令牌数约束；不可见时长取预测的
+// 批次转发耗时加余量，限制在配置的上下界内
+class BatchTuner {
+public:
+    struct Options {
+        bool enable{false};
+        std::size_t min_batch_size{1};
+        std::size_t max_batch_size{32};
+        std::size_t min_invisible_seconds{15};
+        std::size_t max_invisible_seconds{300};
+        // 预测耗时之外的余量，覆盖异步发送的尾部耗时和确认耗时
+        std::size_t invisible_margin_ms{5000};
+    };
+
+    BatchTuner();
+
+    // 以 prefix 为前缀暴露 bvar 指标
+    void expose(const std::string& prefix);
+
+    // 更新配置，保留已有的耗时估计
+    void configure(const Options& options);
+
+    // 本次拉取的批量上限，未启用时返回 fallback
+    std::size_t batch_limit(std::size_t fallback) const;
+
+    // 拉取 batch_size 条消息时使用的不可见时长，未启用时返回 fallback
+    std::chrono::milliseconds invisible_duration(
+        std::size_t batch_size, std::chrono::milliseconds fallback);
+
+    // 记录一个批次的转发耗时
+    void record(std::size_t count, int64_t elapsed_us);
+
+private:
+    mutable std::mutex _mtx;
+    Options _options;
+    double _ms_per_message;    // 单条消息转发耗时的 EWMA，< 0 表示未知
+
+    bvar::Status<int64_t> _batch_size;
+    bvar::Status<int64_t> _invisible_ms;
+    bvar::Status<double> _ms_per_message_status;
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "circuit_breaker.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+namespace bmq {
+
+// 半开状态下探测名额用完后，等待探测结果的轮询间隔
+static constexpr std::chrono::milliseconds kProbeRetryAfter(100);
+
+CircuitBreaker::CircuitBreaker()
+    : _enabled(false),
+      _state(static_cast<int>(State::CLOSED)),
+      _open_until_ms(0),
+      _consecutive_opens(0),
+      _probes_left(0),
+      _probe_successes(0),
+      _probe_deadline_ms(0),
+      _state_status(&CircuitBreaker::get_state, this) {}
+
+void CircuitBreaker::expose(const std::string& prefix) {
+    _state_status.expose(prefix + "_circuit_state");
+    _opened.expose(prefix + "_circuit_opened");
+    _rejected.expose(prefix + "_circuit_rejected");
+}
+
+void CircuitBreaker::configure(const Options& options) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _options = options;
+    _options.window_seconds = std::max<std::size_t>(options.window_seconds, 1);
+    _options.half_open_probes =
+        std::max<std::size_t>(options.half_open_probes, 1);
+    if (_buckets.size() != _options.window_seconds) {
+        _buckets.assign(_options.window_seconds, Bucket());
+    }
+
+    if (!options.enable) {
+        close_locked();
+    }
+    _enabled.store(options.enable, std::memory_order_release);
+}
+
+void CircuitBreaker::reset() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    close_locked();
+}
+
+std::size_t CircuitBreaker::admit(std::size_t max,
+                                  std::chrono::milliseconds* retry_after) {
+    if (!_enabled.load(std::memory_order_acquire) ||
+        state() == State::CLOSED) {
+        return max;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    State current = state();
+    int64_t now = steady_now_ms();
+    if (current == State::OPEN) {
+        if (now < _open_until_ms) {
+            *retry_after = std::chrono::milliseconds(_open_until_ms - now);
+            return 0;
+        }
+
+        SPDLOG_INFO("Circuit breaker half-open, probing target with {} "
+                    "message(s)",
+                    _options.half_open_probes);
+        set_state_locked(State::HALF_OPEN);
+        _probes_left = _options.half_open_probes;
+        _probe_successes = 0;
+        current = State::HALF_OPEN;
+    }
+
+    if (current == State::HALF_OPEN) {
+        // 探测超过慢调用阈值仍无结果，说明被丢弃且未归还，重新放行剩余名额
+        if (_probes_left == 0 && now >= _probe_deadline_ms &&
+            _probe_successes < _options.half_open_probes) {
+            SPDLOG_WARN("Circuit breaker probe(s) reported no result within "
+                        "{} ms, reissuing",
+                        _options.slow_call_ms);
+            _probes_left = _options.half_open_probes - _probe_successes;
+        }
+
+        std::size_t granted = std::min(max, _probes_left);
+        _probes_left -= granted;
+        if (granted == 0) {
+            *retry_after = kProbeRetryAfter;
+        } else {
+            _probe_deadline_ms =
+                now + static_cast<int64_t>(_options.slow_call_ms);
+        }
+        return granted;
+    }
+
+    return max;
+}
+
+void CircuitBreaker::release(std::size_t unused) {
+    if (unused == 0 || state() != State::HALF_OPEN) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (state() == State::HALF_OPEN) {
+        _probes_left += unused;
+    }
+}
+
+bool CircuitBreaker::allow() {
+    if (state() != State::OPEN) {
+        return true;
+    }
+
+    _rejected << 1;
+    return false;
+}
+
+void CircuitBreaker::record(bool success, int64_t latency_us) {
+    if (!_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    bool slow = latency_us >=
+                static_cast<int64_t>(_options.slow_call_ms) * 1000;
+    int64_t now = steady_now_ms();
+
+    switch (state()) {
+        case State::OPEN:
+            // 打开之前发出的请求，结果已不影响状态
+            return;
+        case State::HALF_OPEN:
+            if (!success || slow) {
+                trip_locked(now);
+            } else if (++_probe_successes >= _options.half_open_probes) {
+                SPDLOG_INFO("Circuit breaker closed, target recovered");
+                close_locked();
+            }
+            return;
+        default:
+            break;
+    }
+
+    int64_t second = now / 1000;
+    Bucket& bucket = _buckets[second % _buckets.size()];
+    if (bucket.second != second) {
+        bucket = Bucket();
+        bucket.second = second;
+    }
+    ++bucket.total;
+    bucket.failures += success ? 0 : 1;
+    bucket.slow_calls += slow ? 1 : 0;
+
+    uint64_t total = 0;
+    uint64_t failures = 0;
+    uint64_t slow_calls = 0;
+    int64_t oldest = second - static_cast<int64_t>(_buckets.size()) + 1;
+    for (const auto& b : _buckets) {
+        if (b.second >= oldest) {
+            total += b.total;
+            failures += b.failures;
+            slow_calls += b.slow_calls;
+        }
+    }
+
+    if (total < _options.min_requests) {
+        return;
+    }
+
+    if (failures >= _options.failure_rate_threshold * total ||
+        slow_calls >= _options.slow_call_rate_threshold * total) {
+        SPDLOG_WARN("Circuit breaker opened: {} failure(s), {} slow call(s) "
+                    "in {} request(s)",
+                    failures, slow_calls, total);
+        trip_locked(now);
+    }
+}
+
+int64_t CircuitBreaker::steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+int CircuitBreaker::get_state(void* breaker) {
+    return static_cast<int>(static_cast<CircuitBreaker*>(breaker)->state());
+}
+
+void CircuitBreaker::trip_locked(int64_t now) {
+    // 连续打开时翻倍，避免目标长时间不可用期间频繁探测
+    int64_t open_ms = static_cast<int64_t>(_options.open_ms);
+    int64_t max_open_ms = static_cast<int64_t>(
+        std::max(_options.max_open_ms, _options.open_ms));
+    for (uint32_t i = 0; i < _consecutive_opens && open_ms < max_open_ms;
+         ++i) {
+        open_ms *= 2;
+    }
+    open_ms = std::min(open_ms, max_open_ms);
+
+    ++_consecutive_opens;
+    _open_until_ms = now + open_ms;
+    _probes_left = 0;
+    _probe_successes = 0;
+    _probe_deadline_ms = 0;
+    set_state_locked(State::OPEN);
+    _opened << 1;
+
+    SPDLOG_WARN("Circuit breaker open for {} ms", open_ms);
+}
+
+void CircuitBreaker::close_locked() {
+    _consecutive_opens = 0;
+    _open_until_ms = 0;
+    _probes_left = 0;
+    _probe_successes = 0;
+    _probe_deadline_ms = 0;
+    std::fill(_buckets.begin(), _buckets.end(), Bucket());
+    set_state_locked(State::CLOSED);
+}
+
+void CircuitBreaker::set_state_locked(State state) {
+    _state.store(static_cast<int>(state), std::memory_order_release);
+}
+
+}    // namespace bmq
\ No newline at end of file
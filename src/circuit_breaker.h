@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bvar/bvar.h"
+
+namespace bmq {
+
+// 目标主题发送的熔断器
+//
+// 关闭状态下按秒分桶统计最近 window_seconds 秒的发送结果，失败率或慢调用率
+// 超过阈值时打开。打开期间工作线程不再拉取消息，已拉取的消息不再发送；
+// 打开时长到期后进入半开状态，只放行 half_open_probes 条探测消息，全部成功
+// 则关闭，任一失败则再次打开，连续打开的时长逐次翻倍直至 max_open_ms。
+// 放行后超过 slow_call_ms 仍未记录结果的探测视为丢失，名额重新放行，
+// 避免探测消息未发送又未归还时一直停留在半开状态
+class CircuitBreaker {
+public:
+    enum class State { CLOSED = 0, OPEN = 1, HALF_OPEN = 2 };
+
+    struct Options {
+        bool enable{false};
+        std::size_t window_seconds{10};         // 统计窗口
+        std::size_t min_requests{20};           // 窗口内请求数达到该值才评估
+        double failure_rate_threshold{0.5};     // 失败率阈值
+        std::size_t slow_call_ms{3000};         // 超过该耗时视为慢调用
+        double slow_call_rate_threshold{0.8};   // 慢调用率阈值
+        std::size_t open_ms{1000};              // 首次打开的时长
+        std::size_t max_open_ms{60000};         // 连续打开时长的上限
+        std::size_t half_open_probes{4};        // 半开状态放行的探测消息数
+    };
+
+    CircuitBreaker();
+
+    // 以 prefix 为前缀暴露 bvar 指标
+    void expose(const std::string& prefix);
+
+    // 更新配置，保留当前状态；关闭熔断时恢复为关闭状态
+    void configure(const Options& options);
+
+    // 恢复为关闭状态并清空统计，目标变化时调用
+    void reset();
+
+    // 申请至多 max 条消息的发送名额
+    // 打开期间返回 0 并在 retry_after 中给出建议的等待时间，
+    // 半开状态下返回剩余的探测名额
+    std::size_t admit(std::size_t max, std::chrono::milliseconds* retry_after);
+
+    // 归还 admit 申请后未使用（未发送、不会记录结果）的名额
+    void release(std::size_t unused);
+
+    // 发送已拉取的消息前检查，打开期间返回 false
+    bool allow();
+
+    // 记录一次发送结果
+    void record(bool success, int64_t latency_us);
+
+    State state() const {
+        return static_cast<State>(_state.load(std::memory_order_acquire));
+    }
+
+private:
+    struct Bucket {
+        int64_t second{-1};
+        uint32_t total{0};
+        uint32_t failures{0};
+        uint32_t slow_calls{0};
+    };
+
+    static int64_t steady_now_ms();
+
+    static int get_state(void* breaker);
+
+    void trip_locked(int64_t now);
+
+    void close_locked();
+
+    void set_state_locked(State state);
+
+private:
+    std::atomic<bool> _enabled;
+    std::atomic<int> _state;
+
+    std::mutex _mtx;
+    Options _options;
+    std::vector<Bucket> _buckets;
+    int64_t _open_until_ms;
+    uint32_t _consecutive_opens;     // 连续打开的次数，决定下一次打开的时长
+    std::size_t _probes_left;        // 半开状态下尚未发出的探测名额
+    std::size_t _probe_successes;    // 半开状态下成功的探测数
+    int64_t _probe_deadline_ms;      // 最近放行的探测的结果期限
+
+    bvar::PassiveStatus<int> _state_status;
+    bvar::Adder<int64_t> _opened;      // 打开的次数
+    bvar::Adder<int64_t> _rejected;    // 打开期间未发送的已拉取消息数
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "deadline_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+
+namespace bmq {
+
+// 估计值的平滑系数
+static constexpr double kEwmaAlpha = 0.3;
+
+// 拉取数量低于请求数量的该比例时，认为缓冲队列已基本清空
+static constexpr double kDrainedYield = 0.5;
+
+DeadlinePacer::DeadlinePacer()
+    : _ms_per_message(-1.0),
+      _yield(1.0),
+      _newest_born_ms(0),
+      _probed_lag(-1),
+      _last_update_ms(0) {}
+
+DeadlinePacer::~DeadlinePacer() { stop(); }
+
+void DeadlinePacer::expose(const std::string& prefix) {
+    _target_rate.expose(prefix + "_pacing_target_rate");
+    _backlog_estimate.expose(prefix + "_pacing_backlog_estimate");
+}
+
+bool DeadlinePacer::make_probe_channel(
+    const Options& options, std::unique_ptr<brpc::Channel>* channel) {
+    channel->reset();
+    if (!options.enable || options.lag_probe_url.empty()) {
+        return true;
+    }
+
+    brpc::ChannelOptions channel_options;
+    channel_options.protocol = brpc::PROTOCOL_HTTP;
+    channel_options.timeout_ms =
+        static_cast<int32_t>(options.lag_probe_timeout_ms);
+    channel_options.max_retry = 0;
+
+    auto probe_channel = std::make_unique<brpc::Channel>();
+    if (probe_channel->Init(options.lag_probe_url.c_str(), "",
+                            &channel_options) != 0) {
+        SPDLOG_ERROR("Failed to initialize lag probe channel to {}",
+                     options.lag_probe_url);
+        return false;
+    }
+
+    *channel = std::move(probe_channel);
+    return true;
+}
+
+void DeadlinePacer::configure(const Options& options,
+                              std::unique_ptr<brpc::Channel> probe_channel) {
+    std::thread probe_thread;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        probe_thread = stop_probe_locked();
+        _options = options;
+        _probe_channel = std::move(probe_channel);
+        _ms_per_message = -1.0;
+        _yield = 1.0;
+        _newest_born_ms = 0;
+        _probed_lag.store(-1, std::memory_order_relaxed);
+        _window_id.clear();
+        _last_update_ms = 0;
+    }
+
+    // 旧线程已不会再发布结果，最多等待一次探测超时
+    if (probe_thread.joinable()) {
+        probe_thread.join();
+    }
+}
+
+void DeadlinePacer::stop() {
+    std::thread probe_thread;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        probe_thread = stop_probe_locked();
+    }
+
+    if (probe_thread.joinable()) {
+        probe_thread.join();
+    }
+}
+
+void DeadlinePacer::on_receive(
+    std::size_t requested,
+    const std::vector<rocketmq::MessageConstSharedPtr>& messages) {
+    if (requested == 0) {
+        return;
+    }
+
+    int64_t oldest_born_ms = INT64_MAX;
+    int64_t newest_born_ms = 0;
+    for (const auto& message : messages) {
+        int64_t born_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                message->bornTime().time_since_epoch())
+                .count();
+        oldest_born_ms = std::min(oldest_born_ms, born_ms);
+        newest_born_ms = std::max(newest_born_ms, born_ms);
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_options.enable) {
+        return;
+    }
+
+    double yield = static_cast<double>(messages.size()) / requested;
+    _yield = kEwmaAlpha * yield + (1 - kEwmaAlpha) * _yield;
+
+    if (messages.size() >= 2 && newest_born_ms > oldest_born_ms) {
+        double sample = static_cast<double>(newest_born_ms - oldest_born_ms) /
+                        (messages.size() - 1);
+        _ms_per_message = _ms_per_message < 0
+                              ? sample
+                              : kEwmaAlpha * sample +
+                                    (1 - kEwmaAlpha) * _ms_per_message;
+    }
+
+    _newest_born_ms = std::max(_newest_born_ms, newest_born_ms);
+}
+
+bool DeadlinePacer::update(const std::string& window_id,
+                           int64_t remaining_seconds, double* rate) {
+    // 同一时刻只需要一个线程计算目标速率
+    std::unique_lock<std::mutex> lock(_mtx, std::try_to_lock);
+    if (!lock.owns_lock() || !_options.enable) {
+        return false;
+    }
+
+    int64_t now = now_ms();
+    if (window_id == _window_id &&
+        now - _last_update_ms <
+            static_cast<int64_t>(_options.update_interval_ms)) {
+        return false;
+    }
+    _window_id = window_id;
+    _last_update_ms = now;
+
+    if (_probe_channel && !_probe_thread.joinable()) {
+        start_probe_locked();
+    }
+
+    int64_t backlog = estimate_backlog_locked(now);
+
+    double target = _options.max_rate;
+    if (backlog >= 0) {
+        // 剩余时间不足安全余量时按最大速率追赶
+        int64_t effective_seconds =
+            remaining_seconds -
+            static_cast<int64_t>(_options.safety_margin_seconds);
+        target = effective_seconds > 0
+                     ? static_cast<double>(backlog) / effective_seconds
+                     : _options.max_rate;
+    }
+    target = std::min(std::max(target, _options.min_rate), _options.max_rate);
+
+    _target_rate.set_value(target);
+    _backlog_estimate.set_value(backlog);
+
+    SPDLOG_DEBUG(
+        "Pacing window '{}': backlog {}, remaining {}s, target rate {:.2f}",
+        window_id, backlog, remaining_seconds, target);
+
+    *rate = target;
+    return true;
+}
+
+int64_t DeadlinePacer::now_ms() {
+    // 与消息生产时间使用同一时钟
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+int64_t DeadlinePacer::estimate_backlog_locked(int64_t now) {
+    int64_t probed_lag = _probed_lag.load(std::memory_order_relaxed);
+    if (probed_lag >= 0) {
+        return probed_lag;
+    }
+
+    if (_yield < kDrainedYield) {
+        return 0;
+    }
+
+    if (_ms_per_message <= 0 || _newest_born_ms == 0) {
+        return -1;
+    }
+
+    // 比最新拉取到的消息更晚生产的消息都还在缓冲队列中
+    return static_cast<int64_t>(
+        std::max<int64_t>(0, now - _newest_born_ms) / _ms_per_message);
+}
+
+void DeadlinePacer::start_probe_locked() {
+    _probe_task = std::make_shared<ProbeTask>();
+    _probe_thread = std::thread(
+        &DeadlinePacer::probe_thread_func, this, _probe_task, _probe_channel,
+        _options.lag_probe_url,
+        static_cast<int64_t>(_options.lag_probe_interval_seconds) * 1000);
+}
+
+std::thread DeadlinePacer::stop_probe_locked() {
+    if (_probe_task) {
+        std::lock_guard<std::mutex> lock(_probe_task->mtx);
+        _probe_task->stopped = true;
+        _probe_task->cv.notify_all();
+    }
+    _probe_task.reset();
+    return std::move(_probe_thread);
+}
+
+void DeadlinePacer::probe_thread_func(std::shared_ptr<ProbeTask> task,
+                                      std::shared_ptr<brpc::Channel> channel,
+                                      std::string url, int64_t interval_ms) {
+    while (true) {
+        int64_t lag = probe_lag(channel.get(), url);
+
+        std::unique_lock<std::mutex> lock(task->mtx);
+        // 停止后不再发布，以免覆盖新配置清空后的估计
+        if (task->stopped) {
+            return;
+        }
+        _probed_lag.store(lag, std::memory_order_relaxed);
+
+        if (task->cv.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                              [&task] { return task->stopped; })) {
+            return;
+        }
+    }
+}
+
+int64_t DeadlinePacer::probe_lag(brpc::Channel* channel,
+                                 const std::string& url) {
+    brpc::Controller cntl;
+    cntl.http_request().uri() = url;
+    channel->CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+    if (cntl.Failed()) {
+        SPDLOG_WARN("Failed to probe backlog from {}: {}", url,
+                    cntl.ErrorText());
+        return -1;
+    }
+
+    // 支持直接返回数字或 {"lag": N}
+    try {
+        auto body =
+            nlohmann::json::parse(cntl.response_attachment().to_string());
+        const auto& lag = body.is_object() ? body.at("lag") : body;
+        return std::max<int64_t>(0, lag.get<int64_t>());
+    } catch (const std::exception& e) {
+        SPDLOG_WARN("Invalid backlog probe response from {}: {}", url,
+                    e.what());
+        return -1;
+    }
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "brpc/channel.h"
+#include "bvar/bvar.h"
+#include "rocketmq/Message.h"
+
+namespace bmq {
+
+// 截止时间驱动的调速器
+//
+// 根据缓冲队列的积压估计和当前时间窗口的剩余时间计算目标速率，使积压恰好在
+// 窗口结束前（留出安全余量）被消费完，目标速率不超过配置的最大速率
+//
+// 积压估计有两个来源：
+// 1. 拉取结果：相邻消息的生产时间间隔给出消息密度，最新一条消息的生产时间
+//    到当前时间之间的消息即为尚未拉取的积压；拉取数量明显少于请求数量时
+//    认为缓冲队列已基本清空
+// 2. 可选的 HTTP 探测接口，返回 broker 侧的消费堆积数，优先使用。探测由
+//    后台线程按间隔执行，结果通过原子变量发布，计算目标速率时不做网络调用
+class DeadlinePacer {
+public:
+    struct Options {
+        bool enable{false};
+        double max_rate{0.0};                         // 目标速率上限
+        double min_rate{1.0};                         // 目标速率下限
+        std::size_t safety_margin_seconds{60};        // 窗口结束前的余量
+        std::size_t update_interval_ms{1000};         // 目标速率的更新间隔
+        std::string lag_probe_url;                    // 堆积数探测地址
+        std::size_t lag_probe_interval_seconds{10};    // 堆积数探测间隔
+        std::size_t lag_probe_timeout_ms{500};
+    };
+
+    DeadlinePacer();
+
+    ~DeadlinePacer();
+
+    // 以 prefix 为前缀暴露 bvar 指标
+    void expose(const std::string& prefix);
+
+    // 按配置创建堆积数探测通道，未配置探测地址时为空，失败时返回 false
+    static bool make_probe_channel(const Options& options,
+                                   std::unique_ptr<brpc::Channel>* channel);
+
+    // 更新配置并清空已有的估计，probe_channel 由 make_probe_channel() 创建
+    void configure(const Options& options,
+                   std::unique_ptr<brpc::Channel> probe_channel);
+
+    // 记录一次拉取结果
+    void on_receive(
+        std::size_t requested,
+        const std::vector<rocketmq::MessageConstSharedPtr>& messages);
+
+    // 计算当前窗口的目标速率，未到更新时间或由其他线程更新时返回 false
+    // 配置了探测地址时，首次调用会启动后台探测线程
+    bool update(const std::string& window_id, int64_t remaining_seconds,
+                double* rate);
+
+    // 停止后台探测线程，之后调用 update() 会重新启动
+    void stop();
+
+private:
+    // 一个探测线程的停止信号，线程退出前与其共享
+    struct ProbeTask {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopped{false};
+    };
+
+    static int64_t now_ms();
+
+    // 估计剩余积压消息数，无法估计时返回 -1
+    int64_t estimate_backlog_locked(int64_t now);
+
+    void start_probe_locked();
+
+    // 通知探测线程退出并交出线程，调用方在释放 _mtx 后 join
+    std::thread stop_probe_locked();
+
+    void probe_thread_func(std::shared_ptr<ProbeTask> task,
+                           std::shared_ptr<brpc::Channel> channel,
+                           std::string url, int64_t interval_ms);
+
+    // 请求一次堆积数，失败时返回 -1
+    static int64_t probe_lag(brpc::Channel* channel, const std::string& url);
+
+private:
+    mutable std::mutex _mtx;
+    Options _options;
+
+    // 基于拉取结果的估计
+    double _ms_per_message;    // 相邻消息生产时间间隔的 EWMA，< 0 表示未知
+    double _yield;             // 拉取数量 / 请求数量的 EWMA
+    int64_t _newest_born_ms;
+
+    // 基于探测接口的估计
+    std::shared_ptr<brpc::Channel> _probe_channel;
+    std::shared_ptr<ProbeTask> _probe_task;
+    std::thread _probe_thread;
+    std::atomic<int64_t> _probed_lag;    // 由探测线程发布，< 0 表示未知
+
+    std::string _window_id;
+    int64_t _last_update_ms;
+
+    bvar::Status<double> _target_rate;
+    bvar::Status<int64_t> _backlog_estimate;
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "delivery_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+namespace bmq {
+
+// 向后查找可用窗口的最大天数
+static constexpr int kMaxLookaheadDays = 7;
+
+// t_us 所在本地日期之后第 day_offset 天零点的微秒时间戳
+static int64_t local_day_start_us(int64_t t_us, int day_offset) {
+    std::time_t t = static_cast<std::time_t>(t_us / 1000000);
+    std::tm local_tm;
+    localtime_r(&t, &local_tm);
+    local_tm.tm_hour = 0;
+    local_tm.tm_min = 0;
+    local_tm.tm_sec = 0;
+    local_tm.tm_mday += day_offset;
+    local_tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&local_tm)) * 1000000;
+}
+
+void DeliveryPlanner::configure(std::vector<Window> windows,
+                                int64_t max_ahead_ms) {
+    std::sort(windows.begin(), windows.end(),
+              [](const Window& a, const Window& b) {
+                  return a.start_seconds < b.start_seconds;
+              });
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _windows = std::move(windows);
+    _max_ahead_ms = max_ahead_ms;
+}
+
+std::size_t DeliveryPlanner::allocate(std::size_t count, int64_t now_ms,
+                                      std::vector<int64_t>* slots) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_windows.empty()) {
+        return 0;
+    }
+
+    int64_t now_us = now_ms * 1000;
+    int64_t limit_us = now_us + _max_ahead_ms * 1000;
+    int64_t t_us = std::max(_next_slot_us, now_us);
+
+    std::size_t allocated = 0;
+    while (allocated < count) {
+        int64_t slot_us = 0;
+        double rate = 0.0;
+        if (!find_slot_locked(t_us, &slot_us, &rate) || slot_us > limit_us) {
+            break;
+        }
+
+        slots->push_back(slot_us / 1000);
+        ++allocated;
+
+        t_us = slot_us + std::max<int64_t>(
+                             1, static_cast<int64_t>(std::llround(1e6 / rate)));
+        _next_slot_us = t_us;
+    }
+
+    return allocated;
+}
+
+int64_t DeliveryPlanner::schedule_ahead_ms(int64_t now_ms) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return std::max<int64_t>(0, _next_slot_us / 1000 - now_ms);
+}
+
+bool DeliveryPlanner::find_slot_locked(int64_t t_us, int64_t* slot_us,
+                                       double* rate) const {
+    for (int day = 0; day <= kMaxLookaheadDays; ++day) {
+        int64_t day_start_us = local_day_start_us(t_us, day);
+        for (const auto& window : _windows) {
+            int64_t window_end_us =
+                day_start_us +
+                static_cast<int64_t>(window.end_seconds) * 1000000;
+            if (t_us >= window_end_us) {
+                continue;
+            }
+
+            int64_t window_start_us =
+                day_start_us +
+                static_cast<int64_t>(window.start_seconds) * 1000000;
+            *slot_us = std::max(t_us, window_start_us);
+            *rate = window.rate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace bmq {
+
+// broker_delay 模式下的投递时间规划器
+//
+// 调度器不再等待时间窗口，而是持续消费缓冲队列，并为每条消息分配一个落在
+// 启用的时间窗口内的投递时间，按窗口速率把相邻消息的投递时间间隔 1/rate 秒，
+// 由 broker 的定时消息在投递时间到达后再对下游可见
+//
+// 规划器只记录下一个可用的投递时间，分配是单调推进的：当前窗口排满后顺延到
+// 下一个启用的窗口（可能是第二天）
+class DeliveryPlanner {
+public:
+    struct Window {
+        int32_t start_seconds;    // 当天的起始秒，包含
+        int32_t end_seconds;      // 当天的结束秒，不包含
+        double rate;              // 窗口内的投递速率
+    };
+
+    DeliveryPlanner() : _next_slot_us(0), _max_ahead_ms(0) {}
+
+    // 更新窗口计划，已分配的投递时间保持不变
+    void configure(std::vector<Window> windows, int64_t max_ahead_ms);
+
+    // 为 count 条消息分配投递时间（毫秒时间戳）
+    // 超出最大提前量的消息不分配，返回实际分配的数量
+    std::size_t allocate(std::size_t count, int64_t now_ms,
+                         std::vector<int64_t>* slots);
+
+    // 下一个可用投递时间距 now_ms 的毫秒数
+    int64_t schedule_ahead_ms(int64_t now_ms) const;
+
+private:
+    // 查找 t_us 所在或之后的第一个窗口，返回窗口内不早于 t_us 的时刻
+    bool find_slot_locked(int64_t t_us, int64_t* slot_us, double* rate) const;
+
+private:
+    mutable std::mutex _mtx;
+    std::vector<Window> _windows;    // 按起始时间排序
+    int64_t _next_slot_us;    // 微秒精度，速率高于 1000/s 时间隔不会被截断
+    int64_t _max_ahead_ms;
+};
+
+}    // namespace bmq
\ No newline at end of file
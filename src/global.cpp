@@ -1,5 +1,8 @@
 #include "global.h"
 
+#include "auto_concurrency_limiter.h"
+#include "brpc/server.h"
+#include "local_atomic_ratelimiter.h"
 #include "local_ratelimiter.h"
 #include "redis_ratelimiter.h"
 #include "rocketmq_delay_scheduler.h"
@@ -15,12 +18,17 @@ DEFINE_uint64(log_rotate_size, 10 * 1024 * 1024, "Log rotate size in bytes");
 DEFINE_uint32(log_rotate_count, 5, "Log rotate file count");
 DEFINE_uint32(log_thread_pool_q_size, 8192, "Log thread pool queue size");
 DEFINE_uint32(log_thread_pool_t_num, 1, "Log thread pool thread number");
+DEFINE_int32(builtin_port, -1,
+             "Port of the embedded brpc builtin server (/vars, /status, "
+             "/hotspots, ...), disabled when negative");
 
 namespace bmq {
 
 struct GlobalExtensions {
     LocalRateLimiter local_rate_limiter;
+    LocalAtomicRateLimiter local_atomic_rate_limiter;
     RedisRateLimiter redis_rate_limiter;
+    AutoConcurrencyLimiter auto_concurrency_limiter;
 
     RocketMQDelayScheduler rocketmq_delay_scheduler;
 };
@@ -31,9 +39,15 @@ void register_global_extensions() {
     RateLimiterExtension()->RegisterOrDie(
         "local", &g_global_extensions.local_rate_limiter);
 
+    RateLimiterExtension()->RegisterOrDie(
+        "local_atomic", &g_global_extensions.local_atomic_rate_limiter);
+
     RateLimiterExtension()->RegisterOrDie(
         "redis", &g_global_extensions.redis_rate_limiter);
 
+    RateLimiterExtension()->RegisterOrDie(
+        "auto_concurrency", &g_global_extensions.auto_concurrency_limiter);
+
     SchedulerExtension()->RegisterOrDie(
         "rocketmq_delay_scheduler",
         &g_global_extensions.rocketmq_delay_scheduler);
@@ -126,6 +140,22 @@ bool init_hot_loader() {
     return true;
 }
 
+bool init_builtin_server() {
+    if (FLAGS_builtin_port < 0) {
+        return true;
+    }
+
+    // 仅包含 brpc 内置服务的服务器，用于查看 bvar 指标和在线分析
+    if (brpc::StartDummyServerAt(FLAGS_builtin_port) != 0) {
+        SPDLOG_ERROR("Failed to start builtin server at port {}",
+                     FLAGS_builtin_port);
+        return false;
+    }
+
+    SPDLOG_INFO("Builtin server started at port {}", FLAGS_builtin_port);
+    return true;
+}
+
 bool global_init() {
     register_global_extensions();
 
@@ -137,6 +167,10 @@ bool global_init() {
         return false;
     }
 
+    if (!init_builtin_server()) {
+        return false;
+    }
+
     return true;
 }
 
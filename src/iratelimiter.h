@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -10,12 +12,57 @@ namespace bmq {
 
 class IRateLimiter {
 public:
+    // 异步获取令牌的完成回调：实际获取到的令牌数及下一个令牌的预计等待时间
+    using AcquireCallback = std::function<void(
+        std::size_t granted, std::chrono::milliseconds retry_after)>;
+
     virtual ~IRateLimiter() noexcept = default;
 
     virtual bool init(const std::string& config) = 0;
 
     virtual bool is_allowed() = 0;
 
+    // 一次性尝试获取至多 permits 个令牌，返回实际获取到的令牌数
+    // 返回 0 时，如果实现能够估算下一个令牌的可用时间，则写入 retry_after
+    // 默认实现逐个调用 is_allowed()，具体实现应重写以避免多次调用
+    virtual std::size_t try_acquire(std::size_t permits,
+                                    std::chrono::milliseconds* retry_after) {
+        std::size_t granted = 0;
+        while (granted < permits && is_allowed()) {
+            ++granted;
+        }
+        return granted;
+    }
+
+    // 异步版本的 try_acquire，结果通过 done 回调返回
+    // 默认实现同步调用 try_acquire 后立即回调，依赖网络的实现应重写以避免阻塞
+    virtual void async_try_acquire(std::size_t permits, AcquireCallback done) {
+        std::chrono::milliseconds retry_after(0);
+        std::size_t granted = try_acquire(permits, &retry_after);
+        done(granted, retry_after);
+    }
+
+    // async_try_acquire() 是否真正异步完成（依赖网络的实现返回 true）
+    // 返回 false 时调用方直接调用 try_acquire()，不必为等待结果分配对象
+    virtual bool is_async() const { return false; }
+
+    // 运行时调整令牌生成速率（如按截止时间动态调速），不支持的实现返回 false
+    virtual bool set_rate(double tokens_per_second) { return false; }
+
+    // 是否支持 set_rate()，热加载据此判断能否原地调整速率而不重新创建
+    virtual bool can_set_rate() const { return false; }
+
+    // 并发型限流器的令牌代表在途发送名额，需要在发送结束后归还
+    // 令牌型限流器的令牌用完即止，默认不需要归还
+    virtual bool needs_release() const { return false; }
+
+    // 归还 permits 个未使用的令牌或已结束的在途名额
+    // 令牌型限流器把未用于转发的令牌放回桶中，使其不会白白流失
+    virtual void release(std::size_t permits) {}
+
+    // 报告一次发送的耗时和结果，并发型限流器据此调整并发上限
+    virtual void on_complete(int64_t latency_us, bool success) {}
+
     virtual std::shared_ptr<IRateLimiter> clone() const = 0;
 };
 
@@ -7,6 +7,8 @@
 
 namespace bmq {
 
+class WorkStealingExecutor;
+
 class IScheduler {
 public:
     virtual ~IScheduler() noexcept = default;
@@ -18,6 +20,10 @@ public:
     virtual void stop() = 0;
 
     virtual std::shared_ptr<IScheduler> clone() const = 0;
+
+    // 设置共享执行器，调度任务提交到执行器中运行，需在 start() 之前调用
+    // 未设置时调度器自行创建工作线程
+    virtual void set_executor(std::shared_ptr<WorkStealingExecutor> executor) {}
 };
 
 }    // namespace bmq
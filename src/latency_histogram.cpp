@@ -0,0 +1,110 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bmq {
+
+LatencyHistogram::LatencyHistogram() : _shards(new Shard[kShards]) {
+    for (int i = 0; i < kShards; ++i) {
+        for (auto& count : _shards[i].counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        _shards[i].sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(int64_t value) {
+    uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+    Shard& shard = _shards[shard_index()];
+    shard.counts[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(v, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    snap.counts.assign(kBuckets, 0);
+    for (int i = 0; i < kShards; ++i) {
+        for (int j = 0; j < kBuckets; ++j) {
+            snap.counts[j] +=
+                _shards[i].counts[j].load(std::memory_order_relaxed);
+        }
+        snap.sum += _shards[i].sum.load(std::memory_order_relaxed);
+    }
+
+    for (uint64_t count : snap.counts) {
+        snap.total += count;
+    }
+    return snap;
+}
+
+int LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(value);
+    }
+
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= kMaxValueBits) {
+        return kBuckets - 1;
+    }
+
+    // 最高有效位之后的 kSubBucketBits 位决定子桶
+    int shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBuckets +
+           static_cast<int>((value >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+
+    int shift = index / kSubBuckets - 1;
+    uint64_t sub = static_cast<uint64_t>(index % kSubBuckets + kSubBuckets);
+    return ((sub + 1) << shift) - 1;
+}
+
+std::size_t LatencyHistogram::shard_index() {
+    static std::atomic<std::size_t> s_next_shard(0);
+    thread_local std::size_t t_shard =
+        s_next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return t_shard;
+}
+
+int64_t LatencyHistogram::Snapshot::percentile(double ratio) const {
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(
+        std::ceil(std::min(std::max(ratio, 0.0), 1.0) * total));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return static_cast<int64_t>(
+                bucket_upper_bound(static_cast<int>(i)));
+        }
+    }
+
+    return static_cast<int64_t>(bucket_upper_bound(kBuckets - 1));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(
+    const Snapshot& earlier) const {
+    Snapshot diff = *this;
+    if (earlier.counts.size() != counts.size()) {
+        return diff;
+    }
+
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        diff.counts[i] -= std::min(diff.counts[i], earlier.counts[i]);
+    }
+    diff.total -= std::min(diff.total, earlier.total);
+    diff.sum -= std::min(diff.sum, earlier.sum);
+    return diff;
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bmq {
+
+// 低开销的对数线性直方图（HDR 风格）
+//
+// 数值按最高有效位分组，每组再线性划分为 16 个子桶，任意数值的相对误差不超过
+// 1/16。记录只是一次 relaxed 的原子自增：每个线程固定映射到一个独立缓存行的
+// 分片上，读取时再合并所有分片，记录路径上没有锁也几乎没有缓存行争用
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxValueBits = 40;    // 超出的数值计入最后一个桶
+    static constexpr int kBuckets =
+        (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+    static constexpr int kShards = 16;
+
+    // 合并后的只读快照
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+        uint64_t total{0};
+        uint64_t sum{0};
+
+        // ratio 取值 (0, 1]，返回所在桶的上界
+        int64_t percentile(double ratio) const;
+
+        int64_t max() const { return percentile(1.0); }
+
+        double mean() const {
+            return total == 0 ? 0.0 : static_cast<double>(sum) / total;
+        }
+
+        // 两次快照之差，用于统计一段时间内的分布
+        Snapshot since(const Snapshot& earlier) const;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    // 记录一个非负数值，负数按 0 计
+    void record(int64_t value);
+
+    Snapshot snapshot() const;
+
+    static int bucket_index(uint64_t value);
+
+    // 桶内数值的上界
+    static uint64_t bucket_upper_bound(int index);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBuckets> counts;
+        std::atomic<uint64_t> sum;
+    };
+
+    // 当前线程使用的分片，线程首次记录时轮转分配
+    static std::size_t shard_index();
+
+    std::unique_ptr<Shard[]> _shards;
+};
+
+}    // namespace bmq
\ No newline at end of file
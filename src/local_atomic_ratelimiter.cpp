@@ -0,0 +1,183 @@
+#include "local_atomic_ratelimiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "nlohmann/json.hpp"
+
+namespace bmq {
+
+// 状态字中的时间从初始化前约 2.3 年开始计，满桶时长不超过该值时空桶时刻
+// 不会早于起点
+static constexpr int64_t kEpochLeadNs = int64_t(1) << 56;
+
+// 状态字中时间的上限，约 18 年，扣除起点的提前量后仍足够长期运行
+static constexpr int64_t kMaxStateNs = (int64_t(1) << 59) - 1;
+
+uint64_t LocalAtomicRateLimiter::pack(int64_t empty_at, uint64_t slot) {
+    // 速率极低时满桶时长可能超出起点，截断只会使桶略早装满
+    empty_at = std::min(std::max<int64_t>(empty_at, 0), kMaxStateNs);
+    return (static_cast<uint64_t>(empty_at) << kSlotBits) | slot;
+}
+
+void LocalAtomicRateLimiter::store_rate(uint64_t slot,
+                                        double tokens_per_second) {
+    _rates[slot].interval_ns.store(
+        std::max<int64_t>(1, static_cast<int64_t>(
+                                 std::llround(1e9 / tokens_per_second))),
+        std::memory_order_relaxed);
+    _rates[slot].capacity_ns.store(
+        static_cast<int64_t>(std::llround(_capacity * 1e9 / tokens_per_second)),
+        std::memory_order_relaxed);
+}
+
+bool LocalAtomicRateLimiter::init(const std::string& config) {
+    try {
+        auto json_config = nlohmann::json::parse(config);
+        double tokens_per_second = json_config["rate"].get<double>();
+
+        if (std::abs(tokens_per_second) < 1e-6) {
+            SPDLOG_ERROR(
+                "LocalAtomicRateLimiter init failed: rate must be greater "
+                "than 0");
+            return false;
+        }
+
+        double capacity = 0.0;
+        if (json_config.contains("burst")) {
+            capacity = json_config["burst"].get<double>();
+        }
+
+        _capacity = std::max(capacity, tokens_per_second);
+        _epoch_ns = now_ns() - kEpochLeadNs;
+        store_rate(0, tokens_per_second);
+
+        // 初始为满桶
+        int64_t capacity_ns =
+            _rates[0].capacity_ns.load(std::memory_order_relaxed);
+        _state.store(pack(kEpochLeadNs - capacity_ns, 0),
+                     std::memory_order_release);
+        _initialized = true;
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("LocalAtomicRateLimiter init failed: {}", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool LocalAtomicRateLimiter::is_allowed() {
+    return try_acquire(1, nullptr) == 1;
+}
+
+std::size_t LocalAtomicRateLimiter::try_acquire(
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
+    if (!_initialized) {
+        return permits;
+    }
+
+    int64_t now = now_ns() - _epoch_ns;
+    uint64_t state = _state.load(std::memory_order_acquire);
+
+    while (true) {
+        const Rate& rate = _rates[slot_of(state)];
+        int64_t interval_ns = std::max<int64_t>(
+            1, rate.interval_ns.load(std::memory_order_relaxed));
+        int64_t capacity_ns = rate.capacity_ns.load(std::memory_order_relaxed);
+
+        // 令牌数不超过桶容量，等价于空桶时刻不早于 now - capacity
+        int64_t base = std::max(empty_at_of(state), now - capacity_ns);
+        int64_t available = (now - base) / interval_ns;
+        std::size_t granted = static_cast<std::size_t>(
+            std::min<int64_t>(available, static_cast<int64_t>(permits)));
+
+        if (granted == 0) {
+            // 没有 CAS 确认时，状态字未变化才说明读到的参数属于该状态
+            uint64_t current = _state.load(std::memory_order_acquire);
+            if (current != state) {
+                state = current;
+                continue;
+            }
+
+            if (retry_after) {
+                int64_t wait_ns = base + interval_ns - now;
+                *retry_after = std::chrono::milliseconds(
+                    (wait_ns + 999999) / 1000000);
+            }
+            return 0;
+        }
+
+        int64_t next = base + static_cast<int64_t>(granted) * interval_ns;
+        if (_state.compare_exchange_weak(state, pack(next, slot_of(state)),
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+            return granted;
+        }
+        // CAS 失败时 state 已被更新为最新值，重新计算
+    }
+}
+
+void LocalAtomicRateLimiter::release(std::size_t permits) {
+    if (!_initialized || permits == 0) {
+        return;
+    }
+
+    int64_t now = now_ns() - _epoch_ns;
+    uint64_t state = _state.load(std::memory_order_acquire);
+
+    while (true) {
+        const Rate& rate = _rates[slot_of(state)];
+        int64_t interval_ns = std::max<int64_t>(
+            1, rate.interval_ns.load(std::memory_order_relaxed));
+        int64_t capacity_ns = rate.capacity_ns.load(std::memory_order_relaxed);
+
+        // 归还的令牌数先截断到满桶，避免乘法溢出
+        int64_t full = now - capacity_ns;
+        int64_t base = std::max(empty_at_of(state), full);
+        int64_t returned = capacity_ns / interval_ns + 1;
+        if (permits < static_cast<std::size_t>(returned)) {
+            returned = static_cast<int64_t>(permits);
+        }
+        int64_t next = std::max(base - returned * interval_ns, full);
+        if (_state.compare_exchange_weak(state, pack(next, slot_of(state)),
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+            return;
+        }
+        // CAS 失败时 state 已被更新为最新值，重新计算
+    }
+}
+
+bool LocalAtomicRateLimiter::set_rate(double tokens_per_second) {
+    if (!_initialized || tokens_per_second < 1e-6) {
+        return false;
+    }
+
+    // 调速每秒至多几次，串行化后只有本线程会改写槽位
+    std::lock_guard<std::mutex> lock(_set_rate_mtx);
+    uint64_t state = _state.load(std::memory_order_acquire);
+    uint64_t slot = (slot_of(state) + 1) % kSlotCount;
+    store_rate(slot, tokens_per_second);
+    int64_t new_interval_ns =
+        _rates[slot].interval_ns.load(std::memory_order_relaxed);
+
+    // 保持当前令牌数不变，按新速率换算空桶时刻，与新槽位一起发布
+    int64_t now = now_ns() - _epoch_ns;
+    const Rate& old_rate = _rates[slot_of(state)];
+    int64_t interval_ns = old_rate.interval_ns.load(std::memory_order_relaxed);
+    int64_t capacity_ns = old_rate.capacity_ns.load(std::memory_order_relaxed);
+    uint64_t next = 0;
+    do {
+        int64_t base = std::max(empty_at_of(state), now - capacity_ns);
+        double tokens = static_cast<double>(now - base) / interval_ns;
+        next = pack(now - static_cast<int64_t>(
+                              std::llround(tokens * new_interval_ns)),
+                    slot);
+    } while (!_state.compare_exchange_weak(state, next,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire));
+
+    return true;
+}
+
+}    // namespace bmq
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "iratelimiter.h"
+
+namespace bmq {
+
+// 无锁令牌桶，语义与 LocalRateLimiter 相同
+//
+// 令牌数和上次补充时间被编码进一个 64 位定点数（纳秒）：桶内令牌恰好为 0
+// 的虚拟时刻 empty_at。当前令牌数 = min(capacity, (now - empty_at) /
+// interval)，消耗 n 个令牌即把该时刻向后推进 n * interval，整个更新通过一次
+// CAS 完成，多个工作线程共享同一实例时不再需要互斥锁
+//
+// 速率参数保存在不可变的槽位中，状态字的低位记录当前槽位：set_rate() 把新
+// 参数写入下一个槽位后，与换算后的空桶时刻一起通过一次 CAS 发布，读取方
+// 看到的参数与空桶时刻总是一致的
+class LocalAtomicRateLimiter : public bmq::IRateLimiter {
+public:
+    LocalAtomicRateLimiter()
+        : _initialized(false), _capacity(0.0), _epoch_ns(0), _state(0) {}
+
+    bool init(const std::string& config) override;
+
+    bool is_allowed() override;
+
+    std::size_t try_acquire(std::size_t permits,
+                            std::chrono::milliseconds* retry_after) override;
+
+    bool set_rate(double tokens_per_second) override;
+
+    bool can_set_rate() const override { return true; }
+
+    // 把未使用的令牌放回桶中：空桶时刻向前回退，不超过满桶
+    void release(std::size_t permits) override;
+
+    std::shared_ptr<bmq::IRateLimiter> clone() const override {
+        return std::dynamic_pointer_cast<bmq::IRateLimiter>(
+            std::make_shared<LocalAtomicRateLimiter>());
+    }
+
+private:
+    // 一组速率参数，发布后不再修改，直到槽位被复用
+    // 槽位复用时读取方可能读到新旧混合的值，但此时状态字已经变化，
+    // 读取方的 CAS 必然失败并重新读取，因此字段只需是原子变量以避免数据竞争
+    struct Rate {
+        std::atomic<int64_t> interval_ns{0};    // 生成一个令牌所需的时间
+        std::atomic<int64_t> capacity_ns{0};    // 生成满桶令牌所需的时间
+    };
+
+    // 状态字低 kSlotBits 位为参数槽位，其余位为空桶时刻相对 _epoch_ns 的纳秒数
+    static constexpr int kSlotBits = 4;
+    static constexpr uint64_t kSlotCount = uint64_t(1) << kSlotBits;
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static uint64_t pack(int64_t empty_at, uint64_t slot);
+
+    static int64_t empty_at_of(uint64_t state) {
+        return static_cast<int64_t>(state >> kSlotBits);
+    }
+
+    static uint64_t slot_of(uint64_t state) { return state & (kSlotCount - 1); }
+
+    // 把速率换算为槽位中的参数
+    void store_rate(uint64_t slot, double tokens_per_second);
+
+private:
+    bool _initialized;
+    double _capacity;
+    int64_t _epoch_ns;    // 状态字中时间的起点
+    std::mutex _set_rate_mtx;    // 串行化 set_rate()，获取令牌不加锁
+    Rate _rates[kSlotCount];
+    alignas(64) std::atomic<uint64_t> _state;
+};
+
+}    // namespace bmq
@@ -1,5 +1,7 @@
 #include "local_ratelimiter.h"
 
+#include <cmath>
+
 #include "nlohmann/json.hpp"
 
 namespace bmq {
@@ -35,24 +37,59 @@ bool LocalRateLimiter::init(const std::string& config) {
     return true;
 }
 
-bool LocalRateLimiter::is_allowed() {
+bool LocalRateLimiter::is_allowed() { return try_acquire(1, nullptr) == 1; }
+
+std::size_t LocalRateLimiter::try_acquire(
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
     if (!_initialized) {
-        return true;
+        return permits;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    refill_locked();
+
+    std::size_t granted = static_cast<std::size_t>(
+        std::min(static_cast<double>(permits), std::floor(_tokens)));
+    _tokens -= static_cast<double>(granted);
+
+    if (granted == 0 && retry_after) {
+        // 距离攒够一个令牌还需要的时间
+        double wait_seconds = (1.0 - _tokens) / _tokens_per_second;
+        *retry_after = std::chrono::milliseconds(
+            static_cast<int64_t>(std::ceil(wait_seconds * 1000)));
+    }
+
+    return granted;
+}
+
+bool LocalRateLimiter::set_rate(double tokens_per_second) {
+    if (!_initialized || tokens_per_second < 1e-6) {
+        return false;
     }
 
     std::lock_guard<std::mutex> lock(_mtx);
+    // 先按旧速率结算已流逝时间内的令牌
+    refill_locked();
+    _tokens_per_second = tokens_per_second;
+    return true;
+}
+
+void LocalRateLimiter::release(std::size_t permits) {
+    if (!_initialized || permits == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    refill_locked();
+    _tokens = std::min(_capacity, _tokens + static_cast<double>(permits));
+}
+
+void LocalRateLimiter::refill_locked() {
     auto now = std::chrono::steady_clock::now();
     std::chrono::duration<double> elapsed_seconds = now - _last_refill_time;
     double tokens_to_add = elapsed_seconds.count() * _tokens_per_second;
     _tokens = std::min(_capacity, _tokens + tokens_to_add);
     _last_refill_time = now;
-
-    if (_tokens >= 1.0) {
-        _tokens -= 1.0;
-        return true;
-    }
-
-    return false;
 }
 
 }    // namespace bmq
\ No newline at end of file
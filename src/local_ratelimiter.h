@@ -20,11 +20,25 @@ public:
 
     bool is_allowed() override;
 
+    std::size_t try_acquire(std::size_t permits,
+                            std::chrono::milliseconds* retry_after) override;
+
+    bool set_rate(double tokens_per_second) override;
+
+    bool can_set_rate() const override { return true; }
+
+    // 把未使用的令牌放回桶中，不超过桶容量
+    void release(std::size_t permits) override;
+
     std::shared_ptr<bmq::IRateLimiter> clone() const override {
         return std::dynamic_pointer_cast<bmq::IRateLimiter>(
             std::make_shared<LocalRateLimiter>());
     }
 
+private:
+    // 按流逝时间补充令牌，调用方需持有 _mtx
+    void refill_locked();
+
 private:
     std::mutex _mtx;
     bool _initialized;
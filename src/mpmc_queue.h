@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace bmq {
+
+// 有界无锁多生产者多消费者队列（Dmitry Vyukov 的环形队列算法）
+//
+// 每个槽位带一个序号：序号等于入队位置时槽位可写，等于入队位置 + 1 时槽位
+// 可读。生产者和消费者各自通过 CAS 抢占位置，队列满或空时立即返回 false，
+// 由调用方决定等待方式，从而把背压传递给上游
+template <typename T>
+class MPMCQueue {
+public:
+    // 容量向上取整为 2 的幂
+    explicit MPMCQueue(std::size_t capacity)
+        : _enqueue_pos(0), _dequeue_pos(0) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    // 队列已满时返回 false，value 保持不变
+    bool try_push(T&& value) {
+        std::size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        while (true) {
+            cell = &_cells[pos & _mask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff =
+                static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_enqueue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列为空时返回 false
+    bool try_pop(T& value) {
+        std::size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        while (true) {
+            cell = &_cells[pos & _mask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff =
+                static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (_dequeue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->data);
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+
+    // 近似的元素个数，仅用于监控
+    std::size_t size_approx() const {
+        std::size_t enqueue_pos = _enqueue_pos.load(std::memory_order_relaxed);
+        std::size_t dequeue_pos = _dequeue_pos.load(std::memory_order_relaxed);
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    // 入队和出队位置分别独占缓存行，避免生产者和消费者之间的伪共享
+    static constexpr std::size_t kCacheLineSize = 64;
+
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask;
+    alignas(kCacheLineSize) std::atomic<std::size_t> _enqueue_pos;
+    alignas(kCacheLineSize) std::atomic<std::size_t> _dequeue_pos;
+};
+
+// 在 MPMCQueue 之上提供阻塞等待
+//
+// 入队出队仍走无锁路径，只有队列满或空的一方才加锁并在条件变量上等待；
+// 入队出队成功后仅在有等待方时加锁通知，没有等待时不增加额外开销
+//
+// 等待方的退出条件 done() 在持锁时求值，条件依赖的状态变化后调用
+// notify_all() 唤醒等待方重新检查；deadline() 给出依赖时间的退出条件的
+// 最晚检查时刻，返回 time_point::max() 表示只等待通知
+template <typename T>
+class BlockingMPMCQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit BlockingMPMCQueue(std::size_t capacity)
+        : _queue(capacity), _push_waiters(0), _pop_waiters(0) {}
+
+    bool try_push(T&& value) {
+        if (!_queue.try_push(std::move(value))) {
+            return false;
+        }
+        notify_waiters(_pop_waiters, _not_empty);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        if (!_queue.try_pop(value)) {
+            return false;
+        }
+        notify_waiters(_push_waiters, _not_full);
+        return true;
+    }
+
+    // 队列已满时等待，done() 为 true 时放弃入队并返回 false，value 保持不变
+    template <typename Done, typename Deadline>
+    bool push(T&& value, Done done, Deadline deadline) {
+        if (try_push(std::move(value))) {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (true) {
+            // 先登记再重试，通知方看到登记就会持锁通知，不会错过唤醒
+            _push_waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool stop = done();
+            bool pushed = _queue.try_push(std::move(value));
+            if (pushed) {
+                notify_waiters_locked(_pop_waiters, _not_empty);
+            } else if (!stop) {
+                wait_until(lock, _not_full, deadline());
+            }
+            _push_waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (pushed || stop) {
+                return pushed;
+            }
+        }
+    }
+
+    // 队列为空时等待，done() 为 true 时返回 false
+    // done() 先于出队求值：调用方据此判断上游已退出时，队列中不会再有新元素
+    template <typename Done, typename Deadline>
+    bool pop(T& value, Done done, Deadline deadline) {
+        if (try_pop(value)) {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (true) {
+            _pop_waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool stop = done();
+            bool popped = _queue.try_pop(value);
+            if (popped) {
+                notify_waiters_locked(_push_waiters, _not_full);
+            } else if (!stop) {
+                wait_until(lock, _not_empty, deadline());
+            }
+            _pop_waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (popped || stop) {
+                return popped;
+            }
+        }
+    }
+
+    // 退出条件变化时唤醒所有等待方
+    void notify_all() {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _not_full.notify_all();
+        _not_empty.notify_all();
+    }
+
+    std::size_t capacity() const { return _queue.capacity(); }
+
+    std::size_t size_approx() const { return _queue.size_approx(); }
+
+private:
+    void notify_waiters(const std::atomic<std::size_t>& waiters,
+                        std::condition_variable& cv) {
+        // 与等待方登记后的屏障配对：要么这里看到登记，要么等待方的重试成功
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(_mtx);
+            cv.notify_one();
+        }
+    }
+
+    // 调用方已持有 _mtx
+    static void notify_waiters_locked(const std::atomic<std::size_t>& waiters,
+                                      std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            cv.notify_one();
+        }
+    }
+
+    static void wait_until(std::unique_lock<std::mutex>& lock,
+                           std::condition_variable& cv,
+                           Clock::time_point deadline) {
+        if (deadline == Clock::time_point::max()) {
+            cv.wait(lock);
+        } else {
+            cv.wait_until(lock, deadline);
+        }
+    }
+
+private:
+    MPMCQueue<T> _queue;
+    std::mutex _mtx;
+    std::condition_variable _not_full;
+    std::condition_variable _not_empty;
+    std::atomic<std::size_t> _push_waiters;
+    std::atomic<std::size_t> _pop_waiters;
+};
+
+}    // namespace bmq
\ No newline at end of file
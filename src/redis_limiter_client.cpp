@@ -0,0 +1,248 @@
+#include "redis_limiter_client.h"
+
+#include <map>
+
+#include "brpc/policy/redis_authenticator.h"
+#include "spdlog/spdlog.h"
+
+DEFINE_int32(limiter_redis_connections, 2,
+             "Number of pipelined connections shared by all Redis rate "
+             "limiters of the same address");
+DEFINE_int32(limiter_redis_max_batch, 128,
+             "Max number of limiter commands coalesced into one Redis request");
+
+DECLARE_int32(limiter_script_load_timeout_ms);
+DECLARE_int32(limiter_check_timeout_ms);
+
+namespace bmq {
+
+// 合并请求的上下文，CallMethod 完成后由 brpc 调用 Run() 并自行释放
+struct RedisLimiterClient::BatchClosure : public google::protobuf::Closure {
+    void Run() override {
+        std::unique_ptr<BatchClosure> self_guard(this);
+
+        client->_batch_latency << cntl.latency_us();
+        client->_commands << static_cast<int64_t>(commands.size());
+        if (cntl.Failed()) {
+            client->_failed_batches << 1;
+        }
+
+        for (std::size_t i = 0; i < commands.size(); ++i) {
+            if (cntl.Failed()) {
+                commands[i].done(nullptr, cntl.ErrorText());
+            } else if (static_cast<int>(i) >= response.reply_size()) {
+                commands[i].done(nullptr, "missing reply in pipeline");
+            } else {
+                commands[i].done(&response.reply(i), std::string());
+            }
+        }
+
+        client->on_batch_done(slot);
+    }
+
+    brpc::Controller cntl;
+    brpc::RedisRequest request;
+    brpc::RedisResponse response;
+    std::vector<PendingCommand> commands;
+    std::shared_ptr<RedisLimiterClient> client;
+    std::size_t slot;
+};
+
+std::shared_ptr<RedisLimiterClient> RedisLimiterClient::get(
+    const std::string& address, const std::string& password) {
+    static std::mutex s_mtx;
+    static std::map<std::string, std::weak_ptr<RedisLimiterClient>> s_clients;
+
+    std::lock_guard<std::mutex> lock(s_mtx);
+
+    std::string key = address + "#" + password;
+    auto client = s_clients[key].lock();
+    if (client) {
+        return client;
+    }
+
+    // 同一地址可能因密码不同对应多个客户端，取最小的未被占用的指标序号
+    std::set<std::size_t> used_indexes;
+    for (const auto& entry : s_clients) {
+        auto other = entry.second.lock();
+        if (other && other->_address == address) {
+            used_indexes.insert(other->_metrics_index);
+        }
+    }
+    std::size_t metrics_index = 0;
+    while (used_indexes.count(metrics_index)) {
+        ++metrics_index;
+    }
+
+    client = std::make_shared<RedisLimiterClient>();
+    if (!client->init(address, password, metrics_index)) {
+        return nullptr;
+    }
+
+    s_clients[key] = client;
+    return client;
+}
+
+bool RedisLimiterClient::init(const std::string& address,
+                              const std::string& password,
+                              std::size_t metrics_index) {
+    int connections = std::max(1, FLAGS_limiter_redis_connections);
+
+    if (!password.empty()) {
+        // 由 brpc 在每次建立连接时自动执行 AUTH，断线重连后依然有效
+        _auth = std::make_unique<brpc::policy::RedisAuthenticator>(password);
+    }
+
+    for (int i = 0; i < connections; ++i) {
+        brpc::ChannelOptions options;
+        options.protocol = brpc::PROTOCOL_REDIS;
+        options.max_retry = 3;
+        options.connect_timeout_ms = 500;
+        options.auth = _auth.get();
+        // 不同 connection_group 的 Channel 使用各自独立的连接
+        options.connection_group = "bmq_limiter_" + std::to_string(i);
+
+        auto channel = std::make_unique<brpc::Channel>();
+        if (channel->Init(address.c_str(), &options) != 0) {
+            SPDLOG_ERROR(
+                "RedisLimiterClient init failed: cannot connect to Redis at {}",
+                address);
+            return false;
+        }
+        _channels.push_back(std::move(channel));
+    }
+
+    _address = address;
+    _metrics_index = metrics_index;
+    _slot_busy.assign(_channels.size(), false);
+
+    std::string prefix = "limiter_redis_" + address;
+    if (metrics_index > 0) {
+        prefix += "_" + std::to_string(metrics_index);
+    }
+    _batch_latency.expose(prefix, "batch");
+    _commands.expose(prefix + "_commands");
+    _failed_batches.expose(prefix + "_failed_batches");
+    return true;
+}
+
+bool RedisLimiterClient::load_script(const std::string& script,
+                                     std::string* sha1) {
+    brpc::Controller cntl;
+    brpc::RedisRequest request;
+    brpc::RedisResponse response;
+
+    cntl.set_timeout_ms(FLAGS_limiter_script_load_timeout_ms);
+
+    request.AddCommand("SCRIPT LOAD %b", script.data(), script.size());
+    _channels[0]->CallMethod(nullptr, &cntl, &request, &response, nullptr);
+
+    if (cntl.Failed() || response.reply_size() == 0 ||
+        response.reply(0).type() != brpc::REDIS_REPLY_STRING) {
+        SPDLOG_ERROR("RedisLimiterClient cannot load Lua script into {}: {}",
+                     _address, cntl.ErrorText());
+        return false;
+    }
+
+    *sha1 = response.reply(0).data().as_string();
+    return true;
+}
+
+void RedisLimiterClient::reload_script_async(const std::string& script) {
+    {
+        std::lock_guard<std::mutex> lock(_script_mtx);
+        if (!_loading_scripts.insert(script).second) {
+            return;    // 已有重新加载请求在进行中
+        }
+    }
+
+    // 脚本内容不变则 sha1 不变，加载成功后调用方无需更新 sha1
+    auto self = shared_from_this();
+    async_execute({"SCRIPT", "LOAD", script},
+                  [self, script](const brpc::RedisReply* reply,
+                                 const std::string& error_text) {
+                      if (!reply || reply->is_error()) {
+                          SPDLOG_ERROR(
+                              "RedisLimiterClient failed to reload Lua "
+                              "script: {}",
+                              reply ? reply->error_message() : error_text);
+                      } else {
+                          SPDLOG_INFO(
+                              "RedisLimiterClient reloaded Lua script, sha1: "
+                              "{}",
+                              reply->data().as_string());
+                      }
+
+                      std::lock_guard<std::mutex> lock(self->_script_mtx);
+                      self->_loading_scripts.erase(script);
+                  });
+}
+
+void RedisLimiterClient::async_execute(std::vector<std::string> args,
+                                       ReplyCallback done) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _pending.push_back(PendingCommand{std::move(args), std::move(done)});
+
+    // 所有连接都有在途请求时，命令留在队列中，由最先完成的请求带走
+    for (std::size_t i = 0; i < _slot_busy.size(); ++i) {
+        std::size_t slot = (_next_slot + i) % _slot_busy.size();
+        if (!_slot_busy[slot]) {
+            _slot_busy[slot] = true;
+            _next_slot = slot + 1;
+            std::vector<PendingCommand> batch = take_pending_locked();
+            lock.unlock();
+            send_batch(slot, std::move(batch));
+            return;
+        }
+    }
+}
+
+void RedisLimiterClient::on_batch_done(std::size_t slot) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (_pending.empty()) {
+        _slot_busy[slot] = false;
+        return;
+    }
+
+    std::vector<PendingCommand> batch = take_pending_locked();
+    lock.unlock();
+    send_batch(slot, std::move(batch));
+}
+
+std::vector<RedisLimiterClient::PendingCommand>
+RedisLimiterClient::take_pending_locked() {
+    std::size_t max_batch =
+        static_cast<std::size_t>(std::max(1, FLAGS_limiter_redis_max_batch));
+
+    std::vector<PendingCommand> batch;
+    if (_pending.size() <= max_batch) {
+        batch.swap(_pending);
+    } else {
+        auto split = _pending.begin() + max_batch;
+        batch.assign(std::make_move_iterator(_pending.begin()),
+                     std::make_move_iterator(split));
+        _pending.erase(_pending.begin(), split);
+    }
+    return batch;
+}
+
+void RedisLimiterClient::send_batch(std::size_t slot,
+                                    std::vector<PendingCommand> batch) {
+    auto closure = new BatchClosure;
+    closure->client = shared_from_this();
+    closure->slot = slot;
+    closure->cntl.set_timeout_ms(FLAGS_limiter_check_timeout_ms);
+
+    for (const auto& command : batch) {
+        std::vector<butil::StringPiece> components(command.args.begin(),
+                                                   command.args.end());
+        closure->request.AddCommandByComponents(components.data(),
+                                                components.size());
+    }
+    closure->commands = std::move(batch);
+
+    _channels[slot]->CallMethod(nullptr, &closure->cntl, &closure->request,
+                                &closure->response, closure);
+}
+
+}    // namespace bmq
\ No newline at end of file
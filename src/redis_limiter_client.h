@@ -0,0 +1,88 @@
+#pragma once
+
+#include <gflags/gflags.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "brpc/authenticator.h"
+#include "brpc/channel.h"
+#include "brpc/redis.h"
+#include "bvar/bvar.h"
+
+namespace bmq {
+
+// 进程内共享的 Redis 限流客户端
+//
+// 同一 Redis 地址的所有 RedisRateLimiter 共用一个客户端，客户端内部维护少量
+// 连接，每个连接同一时刻只有一个在途请求。连接繁忙期间到达的命令会被合并到
+// 下一个请求中一次性发送（pipeline），收到响应后再按顺序分发给各自的回调
+class RedisLimiterClient
+    : public std::enable_shared_from_this<RedisLimiterClient> {
+public:
+    // 命令完成回调，失败时 reply 为空且 error_text 描述失败原因
+    // reply 仅在回调执行期间有效
+    using ReplyCallback = std::function<void(const brpc::RedisReply* reply,
+                                             const std::string& error_text)>;
+
+    // 获取指定地址的共享客户端，不存在时创建
+    static std::shared_ptr<RedisLimiterClient> get(
+        const std::string& address, const std::string& password);
+
+    RedisLimiterClient() : _metrics_index(0), _next_slot(0) {}
+
+    // 同步加载 Lua 脚本，成功时返回脚本的 sha1
+    bool load_script(const std::string& script, std::string* sha1);
+
+    // 在后台重新加载 Lua 脚本，同一脚本并发触发时只会发起一次
+    void reload_script_async(const std::string& script);
+
+    // 异步执行一条命令，args 为命令及其参数
+    void async_execute(std::vector<std::string> args, ReplyCallback done);
+
+private:
+    struct PendingCommand {
+        std::vector<std::string> args;
+        ReplyCallback done;
+    };
+
+    struct BatchClosure;
+
+    // metrics_index 区分同一地址、不同密码的客户端的指标名
+    bool init(const std::string& address, const std::string& password,
+              std::size_t metrics_index);
+
+    // 将等待中的命令合并为一个请求在指定连接上发送
+    void send_batch(std::size_t slot, std::vector<PendingCommand> batch);
+
+    // 请求完成后继续发送该连接上等待中的命令，没有则将连接标记为空闲
+    void on_batch_done(std::size_t slot);
+
+    std::vector<PendingCommand> take_pending_locked();
+
+private:
+    std::string _address;
+    std::size_t _metrics_index;
+    std::unique_ptr<brpc::Authenticator> _auth;
+    std::vector<std::unique_ptr<brpc::Channel>> _channels;
+
+    std::mutex _mtx;
+    std::vector<bool> _slot_busy;    // 每个连接是否有在途请求
+    std::size_t _next_slot;
+    std::vector<PendingCommand> _pending;
+
+    std::mutex _script_mtx;
+    std::set<std::string> _loading_scripts;    // 正在后台加载的脚本
+
+    // 以 limiter_redis_<address> 为前缀暴露的指标，同一地址的第二个及之后
+    // 的客户端在前缀后追加 _<序号>
+    bvar::LatencyRecorder _batch_latency;    // 每个 pipeline 请求的耗时
+    bvar::Adder<int64_t> _commands;          // 已执行的限流命令数
+    bvar::Adder<int64_t> _failed_batches;    // 失败的 pipeline 请求数
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "redis_ratelimiter.h"
 
+#include <cmath>
 #include <fstream>
+#include <future>
 
-#include "brpc/redis.h"
 #include "nlohmann/json.hpp"
 
 DEFINE_string(limiter_script_path, "../conf/redis_rate_limiter.lua",
@@ -14,15 +15,47 @@ DEFINE_string(limiter_redis_password, "",
 DEFINE_int32(limiter_script_load_timeout_ms, 1000,
              "Timeout in milliseconds for loading the Lua script into Redis");
 DEFINE_int32(limiter_check_timeout_ms, 100,
-             "Timeout in milliseconds for each is_allowed check");
+             "Timeout in milliseconds for each batch of limiter checks");
+DEFINE_int32(limiter_key_ttl_seconds, 3600,
+             "TTL in seconds of the token bucket key in Redis");
+DEFINE_string(limiter_lease_script_path,
+              "../conf/redis_rate_limiter_lease.lua",
+              "Path to the Lua script for Redis rate limiting in lease mode");
+DEFINE_int32(limiter_lease_ttl_ms, 1000,
+             "Validity in milliseconds of tokens leased from Redis");
+DEFINE_double(limiter_lease_error_ratio, 0.1,
+              "Upper bound of tokens per lease as a ratio of the rate");
 
 namespace bmq {
 
+RedisRateLimiter::~RedisRateLimiter() {
+    if (!_initialized) {
+        return;
+    }
+
+    int64_t returned = _returned_tokens.exchange(0) +
+                       std::max<int64_t>(0, _leased_tokens.exchange(0));
+    if (returned > 0) {
+        // 只申请 0 个令牌，回调不再访问本对象
+        _client->async_execute(
+            make_acquire_args(0, static_cast<std::size_t>(returned)),
+            [](const brpc::RedisReply*, const std::string&) {});
+    }
+}
+
 bool RedisRateLimiter::init(const std::string& config) {
     try {
         auto json_config = nlohmann::json::parse(config);
 
-        std::string lua_script_path = FLAGS_limiter_script_path;
+        bool lease_mode = false;
+        if (json_config.contains("lease")) {
+            lease_mode = json_config["lease"].get<bool>();
+        }
+
+        // 租约模式使用支持归还令牌的脚本
+        std::string lua_script_path = lease_mode
+                                          ? FLAGS_limiter_lease_script_path
+                                          : FLAGS_limiter_script_path;
         if (json_config.contains("script_path")) {
             lua_script_path = json_config["script_path"].get<std::string>();
         }
@@ -68,72 +101,56 @@ bool RedisRateLimiter::init(const std::string& config) {
                 "RedisRateLimiter init failed: rate must be greater than 0");
             return false;
         }
-        double capacity = 0.0;
+        double burst = 0.0;
         if (json_config.contains("burst")) {
-            capacity = json_config["burst"].get<double>();
+            burst = json_config["burst"].get<double>();
         }
-        capacity = std::max(capacity, tokens_per_second);
 
         _bucket_key = bucket_key;
         _tokens_per_second = tokens_per_second;
-        _capacity = capacity;
-
-        // init redis channel
-        brpc::ChannelOptions options;
-        options.protocol = brpc::PROTOCOL_REDIS;
-        options.max_retry = 3;
-        options.connect_timeout_ms = 500;
+        _burst = burst;
+        _capacity = std::max(burst, tokens_per_second);
 
-        if (_redis_channel.Init(redis_address.c_str(), &options) != 0) {
-            SPDLOG_ERROR(
-                "RedisRateLimiter init failed: cannot connect to Redis at {}",
-                redis_address);
-            return false;
-        }
-
-        if (!redis_password.empty()) {
-            brpc::Controller cntl;
-            brpc::RedisRequest request;
-            brpc::RedisResponse response;
+        if (lease_mode) {
+            int64_t lease_ttl_ms = FLAGS_limiter_lease_ttl_ms;
+            if (json_config.contains("lease_ttl_ms")) {
+                lease_ttl_ms = json_config["lease_ttl_ms"].get<int64_t>();
+            }
 
-            request.AddCommand("AUTH " + redis_password);
-            _redis_channel.CallMethod(nullptr, &cntl, &request, &response,
-                                      nullptr);
+            double lease_error_ratio = FLAGS_limiter_lease_error_ratio;
+            if (json_config.contains("lease_error_ratio")) {
+                lease_error_ratio =
+                    json_config["lease_error_ratio"].get<double>();
+            }
 
-            if (cntl.Failed() || response.reply_size() == 0 ||
-                response.reply(0).type() != brpc::REDIS_REPLY_STATUS ||
-                response.reply(0).data() != "OK") {
+            if (lease_ttl_ms <= 0 || lease_error_ratio <= 0.0) {
                 SPDLOG_ERROR(
-                    "RedisRateLimiter init failed: Redis AUTH failed: {}",
-                    cntl.ErrorText());
+                    "RedisRateLimiter init failed: lease_ttl_ms and "
+                    "lease_error_ratio must be greater than 0");
                 return false;
             }
-        }
 
-        {
-            brpc::Controller cntl;
-            brpc::RedisRequest request;
-            brpc::RedisResponse response;
-
-            cntl.set_timeout_ms(
-                FLAGS_limiter_script_load_timeout_ms);    // 1 second timeout
-                                                          // for script loading
-
-            request.AddCommand("SCRIPT LOAD %b", _lua_script.data(),
-                               _lua_script.size());
-            _redis_channel.CallMethod(nullptr, &cntl, &request, &response,
-                                      nullptr);
+            _lease_mode = true;
+            _lease_ttl_ms = lease_ttl_ms;
+            _lease_error_ratio = lease_error_ratio;
+            _lease_max_tokens = lease_max_tokens(tokens_per_second);
+            _last_lease_ms = butil::gettimeofday_ms();
+        }
 
-            if (cntl.Failed() || response.reply_size() == 0 ||
-                response.reply(0).type() != brpc::REDIS_REPLY_STRING) {
-                SPDLOG_ERROR(
-                    "RedisRateLimiter init failed: cannot load Lua script into "
-                    "Redis: {}",
-                    cntl.ErrorText());
-                return false;
-            }
+        // 同一 Redis 地址的限流器共享连接，限流命令在连接上合并发送
+        _client = RedisLimiterClient::get(redis_address, redis_password);
+        if (!_client) {
+            SPDLOG_ERROR(
+                "RedisRateLimiter init failed: cannot connect to Redis at {}",
+                redis_address);
+            return false;
+        }
 
-            _lua_script_sha1 = response.reply(0).data().as_string();
+        if (!_client->load_script(_lua_script, &_lua_script_sha1)) {
+            SPDLOG_ERROR(
+                "RedisRateLimiter init failed: cannot load Lua script into "
+                "Redis");
+            return false;
         }
 
         _initialized = true;
@@ -144,79 +161,311 @@ bool RedisRateLimiter::init(const std::string& config) {
     return true;
 }
 
-bool RedisRateLimiter::is_allowed() {
-    if (!_initialized) {
-        return true;
+bool RedisRateLimiter::is_allowed() { return try_acquire(1, nullptr) == 1; }
+
+std::size_t RedisRateLimiter::try_acquire(
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
+    if (!_initialized || permits == 0) {
+        return permits;
     }
 
-    brpc::Controller cntl;
-    brpc::RedisRequest request;
-    brpc::RedisResponse response;
+    if (_lease_mode) {
+        return acquire_leased(permits, retry_after);
+    }
 
-    cntl.set_timeout_ms(
-        FLAGS_limiter_check_timeout_ms);    // 100 ms timeout for each
-                                            // is_allowed check
+    return acquire_remote(permits, take_returned(), retry_after);
+}
 
-    // 使用 AddCommandByComponents 避免格式化问题
-    std::vector<butil::StringPiece> components;
-    components.emplace_back("EVALSHA");
-    components.emplace_back(_lua_script_sha1);
-    components.emplace_back("1");
-    components.emplace_back(_bucket_key);
-    components.emplace_back(std::to_string(_tokens_per_second));
-    components.emplace_back(std::to_string(_capacity));
-    components.emplace_back(std::to_string(butil::gettimeofday_ms()));
+void RedisRateLimiter::async_try_acquire(std::size_t permits,
+                                         AcquireCallback done) {
+    if (!_initialized || permits == 0) {
+        done(permits, std::chrono::milliseconds(0));
+        return;
+    }
 
-    request.AddCommandByComponents(components.data(), components.size());
+    if (_lease_mode) {
+        acquire_leased_async(permits, std::move(done));
+        return;
+    }
 
-    _redis_channel.CallMethod(nullptr, &cntl, &request, &response, nullptr);
+    acquire_remote_async(permits, take_returned(), std::move(done));
+}
 
-    if (cntl.Failed() || response.reply_size() == 0) {
-        SPDLOG_ERROR("RedisRateLimiter is_allowed failed: {}",
-                     cntl.ErrorText());
-        return true;
+void RedisRateLimiter::release(std::size_t permits) {
+    if (!_initialized || permits == 0) {
+        return;
     }
 
-    if (response.reply(0).is_error()) {
-        SPDLOG_WARN("RedisRateLimiter is_allowed got error reply: {}",
-                    response.reply(0).error_message());
+    if (_lease_mode) {
+        // 租约已过期时，放回的令牌随下一次续租一并归还
+        _leased_tokens.fetch_add(static_cast<int64_t>(permits),
+                                 std::memory_order_release);
+        _consumed_tokens.fetch_sub(static_cast<int64_t>(permits),
+                                   std::memory_order_relaxed);
+        return;
+    }
 
-        cntl.Reset();
-        request.Clear();
-        response.Clear();
+    _returned_tokens.fetch_add(static_cast<int64_t>(permits),
+                               std::memory_order_relaxed);
+}
 
-        std::vector<butil::StringPiece> components;
-        components.emplace_back("EVAL");
-        components.emplace_back(_lua_script);
-        components.emplace_back("1");
-        components.emplace_back(_bucket_key);
-        components.emplace_back(std::to_string(_tokens_per_second));
-        components.emplace_back(std::to_string(_capacity));
-        components.emplace_back(std::to_string(butil::gettimeofday_ms()));
+std::size_t RedisRateLimiter::take_returned() {
+    return static_cast<std::size_t>(std::max<int64_t>(
+        0, _returned_tokens.exchange(0, std::memory_order_relaxed)));
+}
 
-        request.AddCommandByComponents(components.data(), components.size());
+std::size_t RedisRateLimiter::acquire_remote(
+    std::size_t permits, std::size_t returned,
+    std::chrono::milliseconds* retry_after) {
+    auto promise = std::make_shared<
+        std::promise<std::pair<std::size_t, std::chrono::milliseconds>>>();
+    auto future = promise->get_future();
+
+    acquire_remote_async(
+        permits, returned,
+        [promise](std::size_t granted, std::chrono::milliseconds wait) {
+            promise->set_value(std::make_pair(granted, wait));
+        });
+
+    auto result = future.get();
+    if (result.first == 0 && retry_after) {
+        *retry_after = result.second;
+    }
+    return result.first;
+}
 
-        _redis_channel.CallMethod(nullptr, &cntl, &request, &response, nullptr);
+void RedisRateLimiter::acquire_remote_async(std::size_t permits,
+                                            std::size_t returned,
+                                            AcquireCallback done) {
+    auto self = shared_from_this();
+    _client->async_execute(
+        make_acquire_args(permits, returned),
+        [self, permits, done](const brpc::RedisReply* reply,
+                              const std::string& error_text) {
+            std::chrono::milliseconds retry_after(0);
+            std::size_t granted = self->handle_acquire_reply(
+                reply, error_text, permits, &retry_after);
+            done(granted, retry_after);
+        });
+}
 
-        if (cntl.Failed() || response.reply_size() == 0 ||
-            response.reply(0).is_error()) {
-            SPDLOG_ERROR("RedisRateLimiter is_allowed fallback failed: {}",
-                         cntl.ErrorText());
-            return true;
+std::size_t RedisRateLimiter::handle_acquire_reply(
+    const brpc::RedisReply* reply, const std::string& error_text,
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
+    // Redis 不可用时放行，避免限流器故障阻塞消息转发
+    if (!reply) {
+        SPDLOG_ERROR("RedisRateLimiter try_acquire failed: {}", error_text);
+        return permits;
+    }
+
+    if (reply->is_error()) {
+        SPDLOG_WARN("RedisRateLimiter try_acquire got error reply: {}",
+                    reply->error_message());
+
+        // 脚本缓存丢失（如 Redis 重启或 SCRIPT FLUSH）时在后台重新加载一次，
+        // 而不是每次调用都通过 EVAL 发送完整脚本
+        if (std::string(reply->error_message()).rfind("NOSCRIPT", 0) == 0) {
+            _client->reload_script_async(_lua_script);
+        }
+        return permits;
+    }
+
+    // 脚本返回 {granted, wait_ms}
+    if (reply->type() != brpc::REDIS_REPLY_ARRAY || reply->size() != 2 ||
+        !(*reply)[0].is_integer() || !(*reply)[1].is_integer()) {
+        SPDLOG_ERROR("RedisRateLimiter try_acquire unexpected reply type: {}",
+                     reply->type());
+        return permits;
+    }
+
+    std::size_t granted = static_cast<std::size_t>(std::max<int64_t>(
+        0, std::min<int64_t>((*reply)[0].integer(), permits)));
+
+    if (granted == 0 && retry_after) {
+        *retry_after = std::chrono::milliseconds((*reply)[1].integer());
+    }
+
+    return granted;
+}
+
+std::size_t RedisRateLimiter::acquire_leased(
+    std::size_t permits, std::chrono::milliseconds* retry_after) {
+    int64_t now_ms = butil::gettimeofday_ms();
+
+    std::size_t granted = take_from_lease(permits, now_ms);
+    if (granted > 0) {
+        return granted;
+    }
+
+    // 续租与异步请求共用同一个在途续租，同步调用方等待其结果
+    auto promise = std::make_shared<
+        std::promise<std::pair<std::size_t, std::chrono::milliseconds>>>();
+    auto future = promise->get_future();
+    acquire_leased_async(
+        permits,
+        [promise](std::size_t granted, std::chrono::milliseconds wait) {
+            promise->set_value(std::make_pair(granted, wait));
+        });
+
+    auto result = future.get();
+    if (result.first == 0 && retry_after) {
+        *retry_after = result.second;
+    }
+    return result.first;
+}
+
+void RedisRateLimiter::acquire_leased_async(std::size_t permits,
+                                            AcquireCallback done) {
+    int64_t now_ms = butil::gettimeofday_ms();
+    std::size_t granted = take_from_lease(permits, now_ms);
+    if (granted > 0) {
+        done(granted, std::chrono::milliseconds(0));
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_lease_mtx);
+
+    // 等锁期间可能已有续租完成
+    now_ms = butil::gettimeofday_ms();
+    granted = take_from_lease(permits, now_ms);
+    if (granted > 0) {
+        lock.unlock();
+        done(granted, std::chrono::milliseconds(0));
+        return;
+    }
+
+    // 同一时刻只有一个续租在途，其余请求排队等待其结果
+    _lease_waiters.push_back(LeaseWaiter{permits, std::move(done)});
+    if (_renewing) {
+        return;
+    }
+    _renewing = true;
+
+    // 过期租约中剩余的令牌随本次续租一并归还
+    int64_t leftover = std::max<int64_t>(0, _leased_tokens.exchange(0));
+    std::size_t lease_size = next_lease_size(permits, now_ms);
+    lock.unlock();
+
+    auto self = shared_from_this();
+    acquire_remote_async(
+        lease_size, static_cast<std::size_t>(leftover),
+        [self, now_ms](std::size_t leased,
+                       std::chrono::milliseconds retry_after) {
+            self->on_lease_renewed(leased, retry_after, now_ms);
+        });
+}
+
+void RedisRateLimiter::on_lease_renewed(std::size_t leased,
+                                        std::chrono::milliseconds retry_after,
+                                        int64_t lease_start_ms) {
+    std::vector<LeaseWaiter> waiters;
+    std::vector<std::size_t> grants;
+    {
+        std::lock_guard<std::mutex> lock(_lease_mtx);
+        waiters.swap(_lease_waiters);
+        _renewing = false;
+
+        std::size_t remaining = leased;
+        for (const auto& waiter : waiters) {
+            std::size_t granted = std::min(waiter.permits, remaining);
+            remaining -= granted;
+            grants.push_back(granted);
+        }
+
+        if (leased > 0) {
+            _lease_expire_ms.store(lease_start_ms + _lease_ttl_ms,
+                                   std::memory_order_relaxed);
+            // 续租期间放回的令牌已计入 _leased_tokens，不能覆盖
+            _leased_tokens.fetch_add(static_cast<int64_t>(remaining),
+                                     std::memory_order_release);
+            _consumed_tokens.fetch_add(
+                static_cast<int64_t>(leased - remaining),
+                std::memory_order_relaxed);
         }
     }
 
-    if (response.reply(0).type() != brpc::REDIS_REPLY_INTEGER) {
-        SPDLOG_ERROR("RedisRateLimiter is_allowed unexpected reply type: {}",
-                     response.reply(0).type());
-        return true;
+    // 在锁外回调，回调中可能再次获取令牌
+    for (std::size_t i = 0; i < waiters.size(); ++i) {
+        waiters[i].done(grants[i], grants[i] == 0
+                                       ? retry_after
+                                       : std::chrono::milliseconds(0));
+    }
+}
+
+std::size_t RedisRateLimiter::take_from_lease(std::size_t permits,
+                                              int64_t now_ms) {
+    if (now_ms >= _lease_expire_ms.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    int64_t available = _leased_tokens.load(std::memory_order_acquire);
+    while (available > 0) {
+        int64_t take =
+            std::min<int64_t>(available, static_cast<int64_t>(permits));
+        if (_leased_tokens.compare_exchange_weak(available, available - take,
+                                                 std::memory_order_acq_rel)) {
+            _consumed_tokens.fetch_add(take, std::memory_order_relaxed);
+            return static_cast<std::size_t>(take);
+        }
     }
 
-    if (response.reply(0).integer() == 0) {
+    return 0;
+}
+
+std::size_t RedisRateLimiter::next_lease_size(std::size_t permits,
+                                              int64_t now_ms) {
+    // 以上次续租以来的消耗量估算本地消耗速率（指数加权平均）
+    int64_t elapsed_ms = std::max<int64_t>(1, now_ms - _last_lease_ms);
+    // 放回的令牌从消耗量中扣除，扣除后可能短暂为负
+    double sample = std::max<int64_t>(0, _consumed_tokens.exchange(0)) *
+                    1000.0 / elapsed_ms;
+    _consume_rate = _consume_rate * 0.5 + sample * 0.5;
+    _last_lease_ms = now_ms;
+
+    // 租约大小为租约有效期内的预计消耗量，且不超过误差上界
+    double expected = _consume_rate * _lease_ttl_ms / 1000.0;
+    std::size_t lease_size = static_cast<std::size_t>(std::ceil(expected));
+    lease_size = std::max(lease_size, permits);
+    return std::min(lease_size, _lease_max_tokens);
+}
+
+bool RedisRateLimiter::set_rate(double tokens_per_second) {
+    if (!_initialized || tokens_per_second < 1e-6) {
         return false;
     }
 
+    // 令牌桶在 Redis 中按每次请求携带的速率和容量补充令牌，下一次请求即生效
+    _tokens_per_second.store(tokens_per_second, std::memory_order_relaxed);
+    _capacity.store(std::max(_burst, tokens_per_second),
+                    std::memory_order_relaxed);
+
+    // 误差上界按新速率换算，已租出的令牌不受影响
+    if (_lease_mode) {
+        std::lock_guard<std::mutex> lock(_lease_mtx);
+        _lease_max_tokens = lease_max_tokens(tokens_per_second);
+    }
     return true;
 }
 
+std::size_t RedisRateLimiter::lease_max_tokens(
+    double tokens_per_second) const {
+    // 每个实例最多持有 rate * ratio 个未使用的令牌，以此限定全局误差
+    return std::max<std::size_t>(
+        1, static_cast<std::size_t>(tokens_per_second * _lease_error_ratio));
+}
+
+std::vector<std::string> RedisRateLimiter::make_acquire_args(
+    std::size_t permits, std::size_t returned) const {
+    return {"EVALSHA",
+            _lua_script_sha1,
+            "1",
+            _bucket_key,
+            std::to_string(_capacity.load(std::memory_order_relaxed)),
+            std::to_string(_tokens_per_second.load(std::memory_order_relaxed)),
+            std::to_string(butil::gettimeofday_ms()),
+            std::to_string(FLAGS_limiter_key_ttl_seconds),
+            std::to_string(permits),
+            std::to_string(returned)};
+}
+
 }    // namespace bmq
\ No newline at end of file
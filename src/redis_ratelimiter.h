@@ -2,33 +2,137 @@
 
 #include <gflags/gflags.h>
 
-#include "brpc/channel.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include "iratelimiter.h"
+#include "redis_limiter_client.h"
 
 namespace bmq {
 
-class RedisRateLimiter : public bmq::IRateLimiter {
+class RedisRateLimiter
+    : public bmq::IRateLimiter,
+      public std::enable_shared_from_this<RedisRateLimiter> {
 public:
     RedisRateLimiter()
-        : _initialized(false), _tokens_per_second(0.0), _capacity(0.0) {}
+        : _initialized(false),
+          _tokens_per_second(0.0),
+          _burst(0.0),
+          _capacity(0.0),
+          _lease_mode(false),
+          _lease_error_ratio(0.0),
+          _lease_max_tokens(0),
+          _lease_ttl_ms(0),
+          _leased_tokens(0),
+          _lease_expire_ms(0),
+          _consumed_tokens(0),
+          _consume_rate(0.0),
+          _last_lease_ms(0),
+          _renewing(false),
+          _returned_tokens(0) {}
+
+    // 把尚未归还的令牌和未用完的租约交还给 Redis 中的令牌桶
+    ~RedisRateLimiter() override;
 
     bool init(const std::string& config) override;
 
     bool is_allowed() override;
 
+    std::size_t try_acquire(std::size_t permits,
+                            std::chrono::milliseconds* retry_after) override;
+
+    // 通过共享客户端异步执行限流脚本，不阻塞调用线程；租约模式下本地租约
+    // 耗尽时异步续租，续租完成前到达的请求在续租回调中一并完成
+    void async_try_acquire(std::size_t permits, AcquireCallback done) override;
+
+    bool is_async() const override { return true; }
+
+    bool set_rate(double tokens_per_second) override;
+
+    bool can_set_rate() const override { return true; }
+
+    // 租约模式下放回本地租约；否则暂存，随下一次请求通过脚本归还
+    void release(std::size_t permits) override;
+
     std::shared_ptr<bmq::IRateLimiter> clone() const override {
         return std::dynamic_pointer_cast<bmq::IRateLimiter>(
             std::make_shared<RedisRateLimiter>());
     }
 
+private:
+    // 执行一次 Redis 限流脚本，申请 permits 个令牌并归还 returned 个令牌
+    std::size_t acquire_remote(std::size_t permits, std::size_t returned,
+                               std::chrono::milliseconds* retry_after);
+
+    void acquire_remote_async(std::size_t permits, std::size_t returned,
+                              AcquireCallback done);
+
+    // 取出待归还的令牌数
+    std::size_t take_returned();
+
+    // 解析限流脚本的返回结果，Redis 不可用时放行
+    std::size_t handle_acquire_reply(const brpc::RedisReply* reply,
+                                     const std::string& error_text,
+                                     std::size_t permits,
+                                     std::chrono::milliseconds* retry_after);
+
+    // 租约模式：优先从本地租到的令牌中扣减，耗尽或过期后再向 Redis 续租
+    std::size_t acquire_leased(std::size_t permits,
+                               std::chrono::milliseconds* retry_after);
+
+    void acquire_leased_async(std::size_t permits, AcquireCallback done);
+
+    // 续租完成：新租约按到达顺序分给等待的请求，剩余部分留作本地租约
+    void on_lease_renewed(std::size_t leased,
+                          std::chrono::milliseconds retry_after,
+                          int64_t lease_start_ms);
+
+    // 从当前未过期的租约中扣减至多 permits 个令牌
+    std::size_t take_from_lease(std::size_t permits, int64_t now_ms);
+
+    // 根据观测到的本地消耗速率计算下一次租约的令牌数
+    std::size_t next_lease_size(std::size_t permits, int64_t now_ms);
+
+    // 按速率计算单次租约的令牌数上限
+    std::size_t lease_max_tokens(double tokens_per_second) const;
+
+    // 构造执行限流脚本的 EVALSHA 命令参数
+    std::vector<std::string> make_acquire_args(std::size_t permits,
+                                               std::size_t returned) const;
+
 private:
     bool _initialized;
     std::string _lua_script;
     std::string _lua_script_sha1;
     std::string _bucket_key;
-    double _tokens_per_second;
-    double _capacity;
-    brpc::Channel _redis_channel;
+    std::atomic<double> _tokens_per_second;    // 随每次请求传给脚本
+    double _burst;                             // 配置的桶容量
+    std::atomic<double> _capacity;    // max(burst, rate)，随速率调整
+    std::shared_ptr<RedisLimiterClient> _client;
+
+    // 租约模式相关状态
+    bool _lease_mode;
+    double _lease_error_ratio;
+    // 单次租约的令牌数上限（误差上界），随速率调整，受 _lease_mtx 保护
+    std::size_t _lease_max_tokens;
+    int64_t _lease_ttl_ms;            // 租约有效期
+    std::mutex _lease_mtx;            // 保护续租状态，同一时刻只有一个续租在途
+    std::atomic<int64_t> _leased_tokens;
+    std::atomic<int64_t> _lease_expire_ms;
+    std::atomic<int64_t> _consumed_tokens;    // 上次续租以来消耗的令牌数
+    // 以下字段受 _lease_mtx 保护
+    double _consume_rate;      // 本地消耗速率（令牌/秒）
+    int64_t _last_lease_ms;    // 上次续租时间
+    bool _renewing;            // 已有续租请求在途
+    struct LeaseWaiter {
+        std::size_t permits;
+        AcquireCallback done;
+    };
+    std::vector<LeaseWaiter> _lease_waiters;    // 等待续租结果的请求
+
+    // 非租约模式下待归还的令牌数，随下一次限流请求一并交给脚本
+    std::atomic<int64_t> _returned_tokens;
 };
 
 }    // namespace bmq
\ No newline at end of file
@@ -1,20 +1,50 @@
 #include "rocketmq_delay_scheduler.h"
 
+#include <filesystem>
+#include <optional>
 #include <set>
 
+#include "butil/time.h"
 #include "global.h"
 #include "nlohmann/json.hpp"
 #include "yaml-cpp/yaml.h"
 
 namespace bmq {
 
-static short get_current_time() {
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-    std::tm local_tm = *std::localtime(&now_c);
-    return static_cast<short>(local_tm.tm_hour * 100 + local_tm.tm_min);
+// 当前本地时间在当天的秒数
+static int32_t local_seconds_of_day() {
+    std::time_t now_c =
+        std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local_tm;
+    localtime_r(&now_c, &local_tm);
+    return local_tm.tm_hour * 3600 + local_tm.tm_min * 60 + local_tm.tm_sec;
 }
 
+// 窗口起始时刻在当天的秒数
+static int32_t window_start_second(short start) {
+    return (start / 100) * 3600 + (start % 100) * 60;
+}
+
+// 窗口结束时刻在当天的秒数（不包含），结束时间所在的整分钟仍属于窗口
+static int32_t window_end_second(short end) {
+    return (end / 100) * 3600 + (end % 100) * 60 + 60;
+}
+
+// 活动窗口的编码：高 32 位为配置版本号，低 32 位为窗口下标 + 1（0 表示窗口外）
+static uint64_t pack_active_window(uint64_t cfg_version, int32_t window) {
+    return (cfg_version << 32) | static_cast<uint32_t>(window + 1);
+}
+
+// 限流器未给出等待时间时的默认重试间隔
+static constexpr std::chrono::milliseconds kDefaultRetryAfter(50);
+
+// 排空期限过后等待在途请求完成的时长，超时后迟到的回调由其持有的
+// shared_ptr 保证调度器存活
+static constexpr int64_t kInflightGraceMs = 5000;
+
+// 消息组隔离在失败消息最晚重新可见之后额外保留的时长
+static constexpr int64_t kGroupFenceGraceMs = 5000;
+
 static short time_str_to_short(const std::string& time_str) {
     if (time_str.length() != 5 || time_str[2] != ':') {
         throw std::runtime_error("Invalid time format: " + time_str);
@@ -60,7 +90,281 @@ static void validate_time_windows(
     }
 }
 
-RocketMQDelayScheduler::RocketMQDelayScheduler() : _running(false) {}
+static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+static int64_t steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 启用落盘时返回落盘队列，否则返回空
+static std::shared_ptr<SpillQueue> spill_queue_of(
+    const RocketMQDelaySchedulerConfig& cfg) {
+    return cfg.spill.enable ? cfg.spill_queue : nullptr;
+}
+
+// 把发送失败的目标消息写入落盘队列，成功后即可确认缓冲队列中的原消息
+static bool spill_message(SpillQueue* spill_queue,
+                          const rocketmq::SendReceipt& send_receipt) {
+    if (!spill_queue || !send_receipt.message) {
+        return false;
+    }
+
+    if (!spill_queue->append(*send_receipt.message)) {
+        SPDLOG_WARN("Spill queue is full, message will be redelivered");
+        return false;
+    }
+
+    return true;
+}
+
+// 原消息生产时间（毫秒时间戳）的用户属性名
+static const char* const kOriginBornTimeProperty = "BB_ORIGIN_BORN_TIME";
+
+// 死信消息的投递次数和原主题的用户属性名
+static const char* const kDeliveryAttemptsProperty = "BB_DELIVERY_ATTEMPTS";
+static const char* const kOriginTopicProperty = "BB_ORIGIN_TOPIC";
+
+// 构造转发到目标主题的消息：沿用原消息的 tag、keys、用户属性、消息组和链路
+// 上下文，消息体与原消息共享同一块缓冲区而不复制
+static rocketmq::MessageConstPtr build_target_message(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    std::chrono::system_clock::time_point deliver_at) {
+    auto builder = rocketmq::Message::newBuilder();
+    builder.withTopic(cfg.target_producer_topic).forwardFrom(*message);
+
+    // 发送时客户端会改写 born time，原始生产时间以用户属性保留，
+    // 多次转发时保留最早的时间
+    if (!message->properties().count(kOriginBornTimeProperty)) {
+        auto properties = message->properties();
+        properties.emplace(
+            kOriginBornTimeProperty,
+            std::to_string(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    message->bornTime().time_since_epoch())
+                    .count()));
+        builder.withProperties(std::move(properties));
+    }
+
+    // 定时消息，投递时间到达前对下游不可见；定时消息不能同时是顺序消息
+    if (deliver_at.time_since_epoch().count()) {
+        builder.availableAfter(deliver_at).withGroup(std::string());
+    } else if (!cfg.preserve_message_group) {
+        builder.withGroup(std::string());
+    }
+
+    return builder.build();
+}
+
+// 按投递次数计算发送失败后的退避时长，未启用重试时返回 0
+static std::chrono::milliseconds retry_backoff_of(
+    const RocketMQDelaySchedulerConfig& cfg, const rocketmq::Message& message) {
+    if (!cfg.retry.enable) {
+        return std::chrono::milliseconds(0);
+    }
+
+    double backoff_ms = static_cast<double>(cfg.retry.initial_backoff_ms);
+    double max_backoff_ms = static_cast<double>(cfg.retry.max_backoff_ms);
+    for (uint16_t attempt = 1; attempt < message.extension().delivery_attempt &&
+                               backoff_ms < max_backoff_ms;
+         ++attempt) {
+        backoff_ms *= cfg.retry.multiplier;
+    }
+
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(std::min(backoff_ms, max_backoff_ms)));
+}
+
+// 投递次数超过上限、应转入死信主题的消息
+static bool is_dead_letter(const RocketMQDelaySchedulerConfig& cfg,
+                           const rocketmq::Message& message) {
+    return cfg.retry.enable && cfg.retry.max_attempts > 0 &&
+           !cfg.retry.dead_letter_topic.empty() &&
+           message.extension().delivery_attempt > cfg.retry.max_attempts;
+}
+
+// 由落盘记录重建目标消息，已过投递时间的定时消息立即投递
+static rocketmq::MessageConstPtr build_spilled_message(
+    const RocketMQDelaySchedulerConfig& cfg, SpillQueue::Record* record) {
+    auto builder = rocketmq::Message::newBuilder();
+    builder.withTopic(cfg.target_producer_topic)
+        .withTag(std::move(record->tag))
+        .withKeys(std::move(record->keys))
+        .withTraceContext(std::move(record->trace_context))
+        .withProperties(std::move(record->properties))
+        .withBody(std::move(record->body));
+
+    if (record->deliver_at_ms > now_ms()) {
+        builder.availableAfter(std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(record->deliver_at_ms)));
+    } else if (cfg.preserve_message_group) {
+        builder.withGroup(std::move(record->group));
+    }
+
+    return builder.build();
+}
+
+// 消费者的连接参数未变化，可沿用已建立的客户端
+static bool same_consumer(const RocketMQDelaySchedulerConfig& a,
+                          const RocketMQDelaySchedulerConfig& b) {
+    return a.buffer_consumer_access_point == b.buffer_consumer_access_point &&
+           a.buffer_consumer_group == b.buffer_consumer_group &&
+           a.buffer_consumer_topic == b.buffer_consumer_topic &&
+           a.buffer_consumer_await_duration == b.buffer_consumer_await_duration;
+}
+
+// 生产者的接入点和主题（含死信主题）未变化，可沿用已建立的客户端
+static bool same_producer(const RocketMQDelaySchedulerConfig& a,
+                          const RocketMQDelaySchedulerConfig& b) {
+    return a.target_producer_access_point == b.target_producer_access_point &&
+           a.target_producer_topic == b.target_producer_topic &&
+           a.retry.dead_letter_topic == b.retry.dead_letter_topic;
+}
+
+static std::shared_ptr<rocketmq::SimpleConsumer> build_consumer(
+    const RocketMQDelaySchedulerConfig& cfg) {
+    auto consumer =
+        rocketmq::SimpleConsumer::newBuilder()
+            .withGroup(cfg.buffer_consumer_group)
+            .withConfiguration(rocketmq::Configuration::newBuilder()
+                                   .withEndpoints(
+                                       cfg.buffer_consumer_access_point)
+                                   .withSsl(false)
+                                   .build())
+            .subscribe(cfg.buffer_consumer_topic, std::string("*"))
+            .withAwaitDuration(
+                std::chrono::seconds(cfg.buffer_consumer_await_duration))
+            .build();
+
+    return std::make_shared<rocketmq::SimpleConsumer>(std::move(consumer));
+}
+
+static std::shared_ptr<rocketmq::Producer> build_producer(
+    const RocketMQDelaySchedulerConfig& cfg) {
+    // 死信主题与目标主题在同一集群，共用生产者
+    std::vector<std::string> topics{cfg.target_producer_topic};
+    if (!cfg.retry.dead_letter_topic.empty()) {
+        topics.push_back(cfg.retry.dead_letter_topic);
+    }
+
+    auto producer =
+        rocketmq::Producer::newBuilder()
+            .withConfiguration(rocketmq::Configuration::newBuilder()
+                                   .withEndpoints(
+                                       cfg.target_producer_access_point)
+                                   .withSsl(false)
+                                   .build())
+            .withTopics(topics)
+            .build();
+
+    return std::make_shared<rocketmq::Producer>(std::move(producer));
+}
+
+static std::shared_ptr<rocketmq::FifoProducer> build_fifo_producer(
+    const RocketMQDelaySchedulerConfig& cfg) {
+    auto fifo_producer =
+        rocketmq::FifoProducer::newBuilder()
+            .withConfiguration(rocketmq::Configuration::newBuilder()
+                                   .withEndpoints(
+                                       cfg.target_producer_access_point)
+                                   .withSsl(false)
+                                   .build())
+            .withTopics({cfg.target_producer_topic})
+            .withConcurrency(cfg.ordered_lanes)
+            .withRetryPolicy(
+                cfg.ordered_send_attempts,
+                std::chrono::milliseconds(cfg.ordered_retry_backoff_ms),
+                std::chrono::milliseconds(cfg.ordered_max_retry_backoff_ms))
+            .build();
+
+    return std::make_shared<rocketmq::FifoProducer>(std::move(fifo_producer));
+}
+
+static bool same_pacing(const DeadlinePacer::Options& a,
+                        const DeadlinePacer::Options& b) {
+    return a.enable == b.enable && a.max_rate == b.max_rate &&
+           a.min_rate == b.min_rate &&
+           a.safety_margin_seconds == b.safety_margin_seconds &&
+           a.update_interval_ms == b.update_interval_ms &&
+           a.lag_probe_url == b.lag_probe_url &&
+           a.lag_probe_interval_seconds == b.lag_probe_interval_seconds &&
+           a.lag_probe_timeout_ms == b.lag_probe_timeout_ms;
+}
+
+// 归还未用于转发消息的令牌，令牌型限流器把令牌放回桶中
+static void release_permits(IRateLimiter* limiter, std::size_t permits) {
+    if (limiter && permits > 0) {
+        limiter->release(permits);
+    }
+}
+
+// 按 id 查找时间窗口
+static const RocketMQDelaySchedulerConfig::TimeWindow* find_window(
+    const RocketMQDelaySchedulerConfig& cfg, const std::string& id) {
+    for (const auto& window : cfg.time_windows) {
+        if (window.id == id) {
+            return &window;
+        }
+    }
+    return nullptr;
+}
+
+// 限流器的桶容量：burst 与 rate 中的较大值
+static double rate_limiter_capacity(const nlohmann::json& config) {
+    double rate = config.value("rate", 0.0);
+    double burst = config.value("burst", 0.0);
+    return std::max(burst, rate);
+}
+
+// 沿用热加载前同一窗口的限流器，保留令牌桶状态：配置相同时直接沿用；
+// 只有 rate 变化、桶容量不变且限流器支持调整速率时沿用，新速率在配置发布后
+// 设置；其他情况返回空，重新创建。这里不修改限流器，校验失败时旧配置不受影响
+static std::shared_ptr<IRateLimiter> reuse_rate_limiter(
+    const RocketMQDelaySchedulerConfig::TimeWindow& previous,
+    const std::string& type, const std::string& config) {
+    if (!previous.rate_limiter || previous.rate_limiter_type != type) {
+        return nullptr;
+    }
+
+    if (previous.rate_limiter_config == config) {
+        return previous.rate_limiter;
+    }
+
+    nlohmann::json old_json = nlohmann::json::parse(
+        previous.rate_limiter_config, nullptr, false);
+    nlohmann::json new_json = nlohmann::json::parse(config, nullptr, false);
+    if (!old_json.is_object() || !new_json.is_object() ||
+        !new_json.contains("rate") ||
+        rate_limiter_capacity(old_json) != rate_limiter_capacity(new_json)) {
+        return nullptr;
+    }
+
+    old_json.erase("rate");
+    new_json.erase("rate");
+    if (old_json != new_json || !previous.rate_limiter->can_set_rate()) {
+        return nullptr;
+    }
+
+    return previous.rate_limiter;
+}
+
+RocketMQDelayScheduler::RocketMQDelayScheduler()
+    : _running(false),
+      _wake_seq(0),
+      _active_window(0),
+      _local_midnight_ms(0),
+      _drain_deadline_ms(0),
+      _active_send_threads(0),
+      _workers_stopped(false),
+      _callback_state(std::make_shared<CallbackState>()),
+      _circuit_breaker(_callback_state->circuit_breaker),
+      _metrics(_callback_state->metrics) {}
 
 RocketMQDelayScheduler::~RocketMQDelayScheduler() { stop(); }
 
@@ -75,6 +379,9 @@ bool RocketMQDelayScheduler::init(const std::string& name,
 
         RocketMQDelaySchedulerConfig cfg;
 
+        // 热加载时与当前快照比较，沿用未变化的客户端、限流器和落盘队列
+        auto previous_cfg = _cfg.load();
+
         if (config_node["worker_threads"].IsDefined()) {
             cfg.worker_threads =
                 config_node["worker_threads"].as<std::size_t>();
@@ -84,6 +391,15 @@ bool RocketMQDelayScheduler::init(const std::string& name,
             cfg.worker_threads = std::thread::hardware_concurrency();
         }
 
+        if (config_node["weight"].IsDefined()) {
+            cfg.weight = config_node["weight"].as<double>();
+        }
+
+        if (cfg.weight <= 0) {
+            SPDLOG_ERROR("weight must be greater than 0");
+            return false;
+        }
+
         if (config_node["scheduler_interval_seconds"].IsDefined()) {
             cfg.scheduler_interval_seconds =
                 config_node["scheduler_interval_seconds"].as<std::size_t>();
@@ -97,6 +413,375 @@ bool RocketMQDelayScheduler::init(const std::string& name,
             return false;
         }
 
+        if (config_node["forward_mode"].IsDefined()) {
+            std::string forward_mode =
+                config_node["forward_mode"].as<std::string>();
+            if (forward_mode == "sync") {
+                cfg.forward_mode =
+                    RocketMQDelaySchedulerConfig::ForwardMode::SYNC;
+            } else if (forward_mode == "async") {
+                cfg.forward_mode =
+                    RocketMQDelaySchedulerConfig::ForwardMode::ASYNC;
+            } else if (forward_mode == "pipeline") {
+                cfg.forward_mode =
+                    RocketMQDelaySchedulerConfig::ForwardMode::PIPELINE;
+            } else if (forward_mode == "ordered") {
+                cfg.forward_mode =
+                    RocketMQDelaySchedulerConfig::ForwardMode::ORDERED;
+            } else {
+                SPDLOG_ERROR("Unknown forward_mode '{}'", forward_mode);
+                return false;
+            }
+        }
+
+        if (config_node["max_inflight_messages"].IsDefined()) {
+            cfg.max_inflight_messages =
+                config_node["max_inflight_messages"].as<std::size_t>();
+        }
+
+        if (cfg.max_inflight_messages == 0) {
+            SPDLOG_ERROR("max_inflight_messages must be greater than 0");
+            return false;
+        }
+
+        if (config_node["latency_summary_interval_seconds"].IsDefined()) {
+            cfg.latency_summary_interval_seconds =
+                config_node["latency_summary_interval_seconds"]
+                    .as<std::size_t>();
+        }
+
+        YAML::Node pipeline_node = config_node["pipeline"];
+        if (pipeline_node["send_threads"].IsDefined()) {
+            cfg.pipeline_send_threads =
+                pipeline_node["send_threads"].as<std::size_t>();
+        }
+
+        if (pipeline_node["ack_threads"].IsDefined()) {
+            cfg.pipeline_ack_threads =
+                pipeline_node["ack_threads"].as<std::size_t>();
+        }
+
+        if (pipeline_node["queue_capacity"].IsDefined()) {
+            cfg.pipeline_queue_capacity =
+                pipeline_node["queue_capacity"].as<std::size_t>();
+        }
+
+        if (cfg.pipeline_send_threads == 0 || cfg.pipeline_ack_threads == 0 ||
+            cfg.pipeline_queue_capacity == 0) {
+            SPDLOG_ERROR(
+                "pipeline send_threads, ack_threads and queue_capacity must "
+                "be greater than 0");
+            return false;
+        }
+
+        YAML::Node spill_node = config_node["spill"];
+        if (spill_node["enable"].IsDefined()) {
+            cfg.spill.enable = spill_node["enable"].as<bool>();
+        }
+
+        if (spill_node["path"].IsDefined()) {
+            cfg.spill.path = spill_node["path"].as<std::string>();
+        }
+
+        if (spill_node["max_messages"].IsDefined()) {
+            cfg.spill.max_messages =
+                spill_node["max_messages"].as<std::size_t>();
+        }
+
+        if (spill_node["max_bytes"].IsDefined()) {
+            cfg.spill.max_bytes = spill_node["max_bytes"].as<std::size_t>();
+        }
+
+        if (spill_node["sync"].IsDefined()) {
+            cfg.spill.sync = spill_node["sync"].as<bool>();
+        }
+
+        if (spill_node["replay_retry_interval_seconds"].IsDefined()) {
+            cfg.spill.replay_retry_interval_seconds =
+                spill_node["replay_retry_interval_seconds"].as<std::size_t>();
+        }
+
+        // 落盘队列独占存储目录，热加载时沿用已打开的队列
+        if (previous_cfg && previous_cfg->spill_queue) {
+            if (cfg.spill.path != previous_cfg->spill.path) {
+                SPDLOG_WARN("Spill path of scheduler '{}' changed, restart "
+                            "to take effect", _name);
+                cfg.spill.path = previous_cfg->spill.path;
+            }
+            // 新的限额在配置发布后生效
+            cfg.spill_queue = previous_cfg->spill_queue;
+        } else if (cfg.spill.enable) {
+            std::error_code dir_ec;
+            std::filesystem::create_directories(cfg.spill.path, dir_ec);
+            if (dir_ec) {
+                SPDLOG_ERROR("Failed to create spill directory {}: {}",
+                             cfg.spill.path, dir_ec.message());
+                return false;
+            }
+            auto spill_queue = std::make_shared<SpillQueue>();
+            if (!spill_queue->open(cfg.spill.path + "/" + _name, cfg.spill)) {
+                return false;
+            }
+            spill_queue->expose(_name);
+            cfg.spill_queue = std::move(spill_queue);
+        }
+
+        YAML::Node breaker_node = config_node["circuit_breaker"];
+        if (breaker_node["enable"].IsDefined()) {
+            cfg.circuit_breaker.enable = breaker_node["enable"].as<bool>();
+        }
+
+        if (breaker_node["window_seconds"].IsDefined()) {
+            cfg.circuit_breaker.window_seconds =
+                breaker_node["window_seconds"].as<std::size_t>();
+        }
+
+        if (breaker_node["min_requests"].IsDefined()) {
+            cfg.circuit_breaker.min_requests =
+                breaker_node["min_requests"].as<std::size_t>();
+        }
+
+        if (breaker_node["failure_rate_threshold"].IsDefined()) {
+            cfg.circuit_breaker.failure_rate_threshold =
+                breaker_node["failure_rate_threshold"].as<double>();
+        }
+
+        if (breaker_node["slow_call_ms"].IsDefined()) {
+            cfg.circuit_breaker.slow_call_ms =
+                breaker_node["slow_call_ms"].as<std::size_t>();
+        }
+
+        if (breaker_node["slow_call_rate_threshold"].IsDefined()) {
+            cfg.circuit_breaker.slow_call_rate_threshold =
+                breaker_node["slow_call_rate_threshold"].as<double>();
+        }
+
+        if (breaker_node["open_ms"].IsDefined()) {
+            cfg.circuit_breaker.open_ms =
+                breaker_node["open_ms"].as<std::size_t>();
+        }
+
+        if (breaker_node["max_open_ms"].IsDefined()) {
+            cfg.circuit_breaker.max_open_ms =
+                breaker_node["max_open_ms"].as<std::size_t>();
+        }
+
+        if (breaker_node["half_open_probes"].IsDefined()) {
+            cfg.circuit_breaker.half_open_probes =
+                breaker_node["half_open_probes"].as<std::size_t>();
+        }
+
+        YAML::Node retry_node = config_node["retry"];
+        if (retry_node["enable"].IsDefined()) {
+            cfg.retry.enable = retry_node["enable"].as<bool>();
+        }
+
+        if (retry_node["initial_backoff_ms"].IsDefined()) {
+            cfg.retry.initial_backoff_ms =
+                retry_node["initial_backoff_ms"].as<std::size_t>();
+        }
+
+        if (retry_node["max_backoff_ms"].IsDefined()) {
+            cfg.retry.max_backoff_ms =
+                retry_node["max_backoff_ms"].as<std::size_t>();
+        }
+
+        if (retry_node["multiplier"].IsDefined()) {
+            cfg.retry.multiplier = retry_node["multiplier"].as<double>();
+        }
+
+        if (retry_node["max_attempts"].IsDefined()) {
+            cfg.retry.max_attempts =
+                retry_node["max_attempts"].as<std::size_t>();
+        }
+
+        if (retry_node["dead_letter_topic"].IsDefined()) {
+            cfg.retry.dead_letter_topic =
+                retry_node["dead_letter_topic"].as<std::string>();
+        }
+
+        if (cfg.retry.enable && (cfg.retry.initial_backoff_ms == 0 ||
+                                 cfg.retry.multiplier < 1.0)) {
+            SPDLOG_ERROR("retry requires positive initial_backoff_ms and "
+                         "multiplier >= 1");
+            return false;
+        }
+
+        YAML::Node drain_node = config_node["drain"];
+        if (drain_node["timeout_ms"].IsDefined()) {
+            cfg.drain_timeout_ms = drain_node["timeout_ms"].as<std::size_t>();
+        }
+
+        if (drain_node["release_invisible_ms"].IsDefined()) {
+            cfg.drain_release_invisible_ms =
+                drain_node["release_invisible_ms"].as<std::size_t>();
+        }
+
+        YAML::Node ordered_node = config_node["ordered"];
+        if (ordered_node["lanes"].IsDefined()) {
+            cfg.ordered_lanes = ordered_node["lanes"].as<std::size_t>();
+        }
+
+        if (cfg.ordered_lanes == 0) {
+            SPDLOG_ERROR("ordered.lanes must be greater than 0");
+            return false;
+        }
+
+        if (ordered_node["send_attempts"].IsDefined()) {
+            cfg.ordered_send_attempts =
+                ordered_node["send_attempts"].as<std::size_t>();
+        }
+
+        if (ordered_node["retry_backoff_ms"].IsDefined()) {
+            cfg.ordered_retry_backoff_ms =
+                ordered_node["retry_backoff_ms"].as<std::size_t>();
+        }
+
+        if (ordered_node["max_retry_backoff_ms"].IsDefined()) {
+            cfg.ordered_max_retry_backoff_ms =
+                ordered_node["max_retry_backoff_ms"].as<std::size_t>();
+        }
+
+        // 不限次数时一条发送失败的消息会永远阻塞所在通道
+        if (cfg.ordered_send_attempts == 0) {
+            SPDLOG_ERROR("ordered.send_attempts must be greater than 0");
+            return false;
+        }
+
+        if (config_node["schedule_mode"].IsDefined()) {
+            std::string schedule_mode =
+                config_node["schedule_mode"].as<std::string>();
+            if (schedule_mode == "window") {
+                cfg.schedule_mode =
+                    RocketMQDelaySchedulerConfig::ScheduleMode::WINDOW;
+            } else if (schedule_mode == "broker_delay") {
+                cfg.schedule_mode =
+                    RocketMQDelaySchedulerConfig::ScheduleMode::BROKER_DELAY;
+            } else {
+                SPDLOG_ERROR("Unknown schedule_mode '{}'", schedule_mode);
+                return false;
+            }
+        }
+
+        YAML::Node broker_delay_node = config_node["broker_delay"];
+        if (broker_delay_node["max_schedule_ahead_seconds"].IsDefined()) {
+            cfg.broker_delay_max_ahead_seconds =
+                broker_delay_node["max_schedule_ahead_seconds"]
+                    .as<std::size_t>();
+        }
+
+        if (cfg.broker_delay_max_ahead_seconds == 0) {
+            SPDLOG_ERROR(
+                "broker_delay.max_schedule_ahead_seconds must be greater "
+                "than 0");
+            return false;
+        }
+
+        YAML::Node pacing_node = config_node["pacing"];
+        if (pacing_node.IsDefined()) {
+            if (pacing_node["enable"].IsDefined()) {
+                cfg.pacing.enable = pacing_node["enable"].as<bool>();
+            }
+
+            if (pacing_node["max_rate"].IsDefined()) {
+                cfg.pacing.max_rate = pacing_node["max_rate"].as<double>();
+            }
+
+            if (pacing_node["min_rate"].IsDefined()) {
+                cfg.pacing.min_rate = pacing_node["min_rate"].as<double>();
+            }
+
+            if (pacing_node["safety_margin_seconds"].IsDefined()) {
+                cfg.pacing.safety_margin_seconds =
+                    pacing_node["safety_margin_seconds"].as<std::size_t>();
+            }
+
+            if (pacing_node["update_interval_ms"].IsDefined()) {
+                cfg.pacing.update_interval_ms =
+                    pacing_node["update_interval_ms"].as<std::size_t>();
+            }
+
+            if (pacing_node["lag_probe_url"].IsDefined()) {
+                cfg.pacing.lag_probe_url =
+                    pacing_node["lag_probe_url"].as<std::string>();
+            }
+
+            if (pacing_node["lag_probe_interval_seconds"].IsDefined()) {
+                cfg.pacing.lag_probe_interval_seconds =
+                    pacing_node["lag_probe_interval_seconds"]
+                        .as<std::size_t>();
+            }
+
+            if (pacing_node["lag_probe_timeout_ms"].IsDefined()) {
+                cfg.pacing.lag_probe_timeout_ms =
+                    pacing_node["lag_probe_timeout_ms"].as<std::size_t>();
+            }
+        }
+
+        YAML::Node adaptive_node = config_node["adaptive_batch"];
+        if (adaptive_node["enable"].IsDefined()) {
+            cfg.adaptive_batch.enable = adaptive_node["enable"].as<bool>();
+        }
+
+        if (adaptive_node["min_batch_size"].IsDefined()) {
+            cfg.adaptive_batch.min_batch_size =
+                adaptive_node["min_batch_size"].as<std::size_t>();
+        }
+
+        if (adaptive_node["max_batch_size"].IsDefined()) {
+            cfg.adaptive_batch.max_batch_size =
+                adaptive_node["max_batch_size"].as<std::size_t>();
+        }
+
+        if (adaptive_node["min_invisible_seconds"].IsDefined()) {
+            cfg.adaptive_batch.min_invisible_seconds =
+                adaptive_node["min_invisible_seconds"].as<std::size_t>();
+        }
+
+        if (adaptive_node["max_invisible_seconds"].IsDefined()) {
+            cfg.adaptive_batch.max_invisible_seconds =
+                adaptive_node["max_invisible_seconds"].as<std::size_t>();
+        }
+
+        if (adaptive_node["invisible_margin_ms"].IsDefined()) {
+            cfg.adaptive_batch.invisible_margin_ms =
+                adaptive_node["invisible_margin_ms"].as<std::size_t>();
+        }
+
+        if (cfg.adaptive_batch.enable) {
+            if (cfg.adaptive_batch.min_batch_size == 0 ||
+                cfg.adaptive_batch.min_batch_size >
+                    cfg.adaptive_batch.max_batch_size) {
+                SPDLOG_ERROR(
+                    "adaptive_batch.min_batch_size must be in "
+                    "[1, adaptive_batch.max_batch_size]");
+                return false;
+            }
+
+            if (cfg.adaptive_batch.min_invisible_seconds <= 10 ||
+                cfg.adaptive_batch.min_invisible_seconds >
+                    cfg.adaptive_batch.max_invisible_seconds) {
+                SPDLOG_ERROR(
+                    "adaptive_batch.min_invisible_seconds must be greater "
+                    "than 10 and not greater than max_invisible_seconds");
+                return false;
+            }
+        }
+
+        if (cfg.pacing.enable) {
+            if (cfg.pacing.max_rate <= 0) {
+                SPDLOG_ERROR("pacing.max_rate must be greater than 0");
+                return false;
+            }
+
+            if (cfg.pacing.min_rate <= 0 ||
+                cfg.pacing.min_rate > cfg.pacing.max_rate) {
+                SPDLOG_ERROR(
+                    "pacing.min_rate must be in (0, pacing.max_rate]");
+                return false;
+            }
+        }
+
         YAML::Node rocketmq_node = config_node["rocketmq"];
 
         if (rocketmq_node["buffer_consumer_topic"].IsDefined()) {
@@ -186,40 +871,61 @@ bool RocketMQDelayScheduler::init(const std::string& name,
             return false;
         }
 
-        auto consumer =
-            rocketmq::SimpleConsumer::newBuilder()
-                .withGroup(cfg.buffer_consumer_group)
-                .withConfiguration(
-                    rocketmq::Configuration::newBuilder()
-                        .withEndpoints(cfg.buffer_consumer_access_point)
-                        .withSsl(false)
-                        .build())
-                .subscribe(cfg.buffer_consumer_topic, std::string("*"))
-                .withAwaitDuration(
-                    std::chrono::seconds(cfg.buffer_consumer_await_duration))
-                .build();
-
-        cfg.buffer_mq_consumer =
-            std::make_shared<rocketmq::SimpleConsumer>(std::move(consumer));
-
-        auto producer =
-            rocketmq::Producer::newBuilder()
-                .withConfiguration(
-                    rocketmq::Configuration::newBuilder()
-                        .withEndpoints(cfg.target_producer_access_point)
-                        .withSsl(false)
-                        .build())
-                .withTopics({cfg.target_producer_topic})
-                .build();
-
-        cfg.target_mq_producer =
-            std::make_shared<rocketmq::Producer>(std::move(producer));
+        if (rocketmq_node["preserve_message_group"].IsDefined()) {
+            cfg.preserve_message_group =
+                rocketmq_node["preserve_message_group"].as<bool>();
+        }
+
+        // 接入点、消费者组和主题不变的客户端沿用当前快照中的实例，
+        // 避免重新建连和路由发现
+        if (previous_cfg && same_consumer(*previous_cfg, cfg)) {
+            cfg.buffer_mq_consumer = previous_cfg->buffer_mq_consumer;
+        } else {
+            cfg.buffer_mq_consumer = build_consumer(cfg);
+        }
+
+        if (previous_cfg && same_producer(*previous_cfg, cfg)) {
+            cfg.target_mq_producer = previous_cfg->target_mq_producer;
+        } else {
+            cfg.target_mq_producer = build_producer(cfg);
+        }
+
+        if (cfg.forward_mode ==
+            RocketMQDelaySchedulerConfig::ForwardMode::ORDERED) {
+            // 定时消息不能是顺序消息，消息组被丢弃后无法按组排序
+            if (cfg.schedule_mode ==
+                    RocketMQDelaySchedulerConfig::ScheduleMode::BROKER_DELAY ||
+                !cfg.preserve_message_group) {
+                SPDLOG_ERROR(
+                    "forward_mode 'ordered' requires schedule_mode 'window' "
+                    "and preserve_message_group");
+                return false;
+            }
+
+            if (previous_cfg && previous_cfg->target_fifo_producer &&
+                previous_cfg->ordered_lanes == cfg.ordered_lanes &&
+                previous_cfg->ordered_send_attempts ==
+                    cfg.ordered_send_attempts &&
+                previous_cfg->ordered_retry_backoff_ms ==
+                    cfg.ordered_retry_backoff_ms &&
+                previous_cfg->ordered_max_retry_backoff_ms ==
+                    cfg.ordered_max_retry_backoff_ms &&
+                same_producer(*previous_cfg, cfg)) {
+                cfg.target_fifo_producer = previous_cfg->target_fifo_producer;
+            } else {
+                cfg.target_fifo_producer = build_fifo_producer(cfg);
+            }
+        }
 
         YAML::Node time_windows_node = config_node["time_windows"];
 
         // 用于检查时间窗口 id 重复
         std::set<std::string> window_ids;
 
+        // 沿用的限流器及其配置的速率，配置发布后恢复为配置的速率
+        std::vector<std::pair<std::shared_ptr<IRateLimiter>, double>>
+            reused_limiters;
+
         for (const auto& time_window_node : time_windows_node) {
             RocketMQDelaySchedulerConfig::TimeWindow window;
 
@@ -264,27 +970,50 @@ bool RocketMQDelayScheduler::init(const std::string& name,
                         time_window_node["rate_limiter_type"].as<std::string>();
                 }
 
-                // 如果是 Redis 限流器，自动设置 bucket_key 为
-                // scheduler_name:window_id
-                if (rate_limiter_type == "redis") {
-                    try {
-                        auto json_config =
-                            nlohmann::json::parse(rate_limiter_config);
+                try {
+                    auto json_config =
+                        nlohmann::json::parse(rate_limiter_config);
+
+                    // 记录窗口速率，broker_delay 模式据此分配投递时间
+                    if (json_config.contains("rate")) {
+                        window.rate = json_config["rate"].get<double>();
+                    }
+
+                    // 如果是 Redis 限流器，自动设置 bucket_key 为
+                    // scheduler_name:window_id
+                    if (rate_limiter_type == "redis") {
                         std::string bucket_key = _name + ":" + window.id;
                         json_config["bucket_key"] = bucket_key;
                         rate_limiter_config = json_config.dump();
-                    } catch (const std::exception& e) {
-                        SPDLOG_ERROR(
-                            "Failed to set bucket_key for Redis rate limiter: "
-                            "{}",
-                            e.what());
-                        return false;
                     }
+                } catch (const std::exception& e) {
+                    SPDLOG_ERROR(
+                        "Invalid rate_limiter_config for time window '{}': {}",
+                        window.id, e.what());
+                    return false;
+                }
+
+                window.rate_limiter_type = rate_limiter_type;
+                window.rate_limiter_config = rate_limiter_config;
+
+                const RocketMQDelaySchedulerConfig::TimeWindow*
+                    previous_window =
+                        previous_cfg ? find_window(*previous_cfg, window.id)
+                                     : nullptr;
+                if (previous_window) {
+                    window.rate_limiter = reuse_rate_limiter(
+                        *previous_window, rate_limiter_type,
+                        rate_limiter_config);
                 }
 
                 const IRateLimiter* rate_limiter_ext =
                     RateLimiterExtension()->Find(rate_limiter_type.c_str());
-                if (rate_limiter_ext) {
+                if (window.rate_limiter) {
+                    SPDLOG_INFO("Reusing rate limiter of time window '{}'",
+                                window.id);
+                    reused_limiters.emplace_back(window.rate_limiter,
+                                                 window.rate);
+                } else if (rate_limiter_ext) {
                     auto rate_limiter = rate_limiter_ext->clone();
                     if (rate_limiter->init(rate_limiter_config)) {
                         window.rate_limiter = rate_limiter;
@@ -311,7 +1040,105 @@ bool RocketMQDelayScheduler::init(const std::string& name,
 
         validate_time_windows(cfg.time_windows);
 
-        _cfg.Modify(modify, cfg);
+        // 按排序后的窗口下标生成切换表
+        for (std::size_t i = 0; i < cfg.time_windows.size(); ++i) {
+            const auto& window = cfg.time_windows[i];
+            if (window.enable) {
+                cfg.schedule.add(window_start_second(window.start),
+                                 window_end_second(window.end),
+                                 static_cast<int32_t>(i));
+            }
+        }
+        cfg.schedule.compile();
+
+        std::vector<DeliveryPlanner::Window> plan;
+        if (cfg.schedule_mode ==
+            RocketMQDelaySchedulerConfig::ScheduleMode::BROKER_DELAY) {
+            for (const auto& window : cfg.time_windows) {
+                if (!window.enable) {
+                    continue;
+                }
+
+                if (window.rate <= 0) {
+                    SPDLOG_ERROR(
+                        "Time window '{}' must have a positive rate in "
+                        "broker_delay mode",
+                        window.id);
+                    return false;
+                }
+
+                // 结束时间所在的整分钟仍属于窗口
+                plan.push_back(
+                    DeliveryPlanner::Window{window_start_second(window.start),
+                                            window_end_second(window.end),
+                                            window.rate});
+            }
+
+            if (plan.empty()) {
+                SPDLOG_ERROR("No enabled time window for broker_delay mode");
+                return false;
+            }
+        }
+
+        // 调速配置不变时保留已有的积压估计
+        bool reconfigure_pacer =
+            !previous_cfg || !same_pacing(previous_cfg->pacing, cfg.pacing);
+        std::unique_ptr<brpc::Channel> probe_channel;
+        if (reconfigure_pacer &&
+            !DeadlinePacer::make_probe_channel(cfg.pacing, &probe_channel)) {
+            return false;
+        }
+
+        // 目标变化后旧目标的熔断状态不再适用
+        bool target_changed =
+            previous_cfg && (previous_cfg->target_producer_access_point !=
+                                 cfg.target_producer_access_point ||
+                             previous_cfg->target_producer_topic !=
+                                 cfg.target_producer_topic);
+
+        // 以上只构造和校验新配置，任何一步失败都不影响运行中的旧配置；
+        // 全部通过后先发布快照，再把新配置应用到沿用的组件上
+        auto published =
+            std::make_shared<const RocketMQDelaySchedulerConfig>(
+                std::move(cfg));
+        _cfg.publish(published);
+
+        if (published->spill_queue) {
+            published->spill_queue->configure(published->spill);
+        }
+
+        // 沿用的限流器可能被调速改过速率，关闭调速后不能停留在调速结果上；
+        // 仍在调速时下一次调速更新会重新设置
+        for (const auto& reused : reused_limiters) {
+            if (reused.second > 0 && reused.first->can_set_rate()) {
+                reused.first->set_rate(reused.second);
+            }
+        }
+
+        if (!plan.empty()) {
+            _delivery_planner.configure(
+                std::move(plan),
+                static_cast<int64_t>(
+                    published->broker_delay_max_ahead_seconds) *
+                    1000);
+        }
+
+        if (reconfigure_pacer) {
+            _pacer.configure(published->pacing, std::move(probe_channel));
+        }
+        _pacer.expose(_name);
+
+        if (target_changed) {
+            _circuit_breaker.reset();
+        }
+        _circuit_breaker.configure(published->circuit_breaker);
+        _circuit_breaker.expose(_name);
+        _batch_tuner.configure(published->adaptive_batch);
+        _batch_tuner.expose(_name);
+        _metrics.expose(_name);
+
+        notify_clock();
+        wake_workers();
     } catch (const std::exception& e) {
         SPDLOG_ERROR("Failed to initialize RocketMQDelayScheduler: {}",
                      e.what());
@@ -327,17 +1154,55 @@ void RocketMQDelayScheduler::start() {
         return;
     }
 
-    butil::DoublyBufferedData<RocketMQDelaySchedulerConfig>::ScopedPtr cfg_ptr;
-    if (_cfg.Read(&cfg_ptr)) {
+    auto cfg_ptr = _cfg.load();
+    if (!cfg_ptr) {
         SPDLOG_ERROR("Failed to read configuration for RocketMQDelayScheduler");
         return;
     }
 
     _running = true;
+    _workers_stopped = false;
+
+    // 流水线模式下先启动下游阶段，再启动拉取线程
+    if (cfg_ptr->forward_mode ==
+        RocketMQDelaySchedulerConfig::ForwardMode::PIPELINE) {
+        _send_queue = std::make_unique<BlockingMPMCQueue<PipelineItem>>(
+            cfg_ptr->pipeline_queue_capacity);
+        _ack_queue = std::make_unique<BlockingMPMCQueue<PipelineItem>>(
+            cfg_ptr->pipeline_queue_capacity);
+
+        _active_send_threads = cfg_ptr->pipeline_send_threads;
+        for (std::size_t i = 0; i < cfg_ptr->pipeline_send_threads; ++i) {
+            _send_threads.emplace_back(
+                &RocketMQDelayScheduler::pipeline_send_thread_func, this);
+        }
 
-    for (std::size_t i = 0; i < cfg_ptr->worker_threads; ++i) {
-        _worker_threads.emplace_back(
-            &RocketMQDelayScheduler::worker_thread_func, this);
+        for (std::size_t i = 0; i < cfg_ptr->pipeline_ack_threads; ++i) {
+            _ack_threads.emplace_back(
+                &RocketMQDelayScheduler::pipeline_ack_thread_func, this);
+        }
+    }
+
+    // 分组需在时钟线程之前创建，时钟线程会通过 wake_workers() 访问分组
+    if (_executor) {
+        _executor_group = _executor->create_group(
+            _name, cfg_ptr->worker_threads, cfg_ptr->weight);
+    }
+
+    _clock_thread =
+        std::thread(&RocketMQDelayScheduler::clock_thread_func, this);
+
+    // 使用共享执行器时提交 worker_threads 个任务，任务之间不共享状态
+    if (_executor) {
+        for (std::size_t i = 0; i < cfg_ptr->worker_threads; ++i) {
+            schedule_worker_task(std::make_shared<WorkerState>(),
+                                 std::chrono::milliseconds(0), wake_seq());
+        }
+    } else {
+        for (std::size_t i = 0; i < cfg_ptr->worker_threads; ++i) {
+            _worker_threads.emplace_back(
+                &RocketMQDelayScheduler::worker_thread_func, this);
+        }
     }
 
     // 启动工作线程后再启用配置热加载
@@ -349,119 +1214,1183 @@ void RocketMQDelayScheduler::stop() {
         return;
     }
 
-    _running = false;
+    auto cfg = _cfg.load();
+    {
+        // 持锁修改，避免等待在途名额的工作线程错过唤醒
+        // 停止拉取后，已拉取的消息在排空期限内继续发送
+        std::lock_guard<std::mutex> lock(_callback_state->inflight_mtx);
+        _drain_deadline_ms =
+            steady_now_ms() +
+            static_cast<int64_t>(cfg ? cfg->drain_timeout_ms : 0);
+        _running = false;
+    }
+    _callback_state->inflight_cv.notify_all();
+    notify_clock();
+    wake_workers();
+    if (_send_queue) {
+        _send_queue->notify_all();
+        _ack_queue->notify_all();
+    }
 
     // 注销热加载任务
     HotLoader::instance().unregister_task(_hot_load_task.get());
     _hot_load_task.reset();
 
+    if (_executor_group) {
+        _executor->close_group(_executor_group);
+    }
+
     for (auto& thread : _worker_threads) {
         if (thread.joinable()) {
             thread.join();
         }
     }
+    _worker_threads.clear();
+    _workers_stopped = true;
+    if (_send_queue) {
+        _send_queue->notify_all();
+    }
+
+    if (_clock_thread.joinable()) {
+        _clock_thread.join();
+    }
+    // 时钟线程退出后不会再有 wake_workers() 访问分组
+    _executor_group.reset();
+
+    // 工作线程退出后不再计算目标速率，探测线程无需继续运行
+    _pacer.stop();
+
+    // 按拉取、发送、确认的顺序停止流水线，已发送的消息全部确认后再退出
+    for (auto& thread : _send_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    _send_threads.clear();
+
+    // 超过排空期限仍未发送的消息立即释放给其他实例
+    if (_send_queue) {
+        PipelineItem item;
+        while (_send_queue->try_pop(item)) {
+            _circuit_breaker.release(1);
+            _callback_state->release_message(
+                item.consumer, item.message,
+                std::chrono::milliseconds(
+                    cfg ? cfg->drain_release_invisible_ms : 0));
+        }
+    }
+
+    for (auto& thread : _ack_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    _ack_threads.clear();
+    _send_queue.reset();
+    _ack_queue.reset();
+
+    // 等待在途消息完成确认；超时后迟到的回调只访问回调状态，不访问调度器
+    wait_inflight_drained();
 }
 
 void RocketMQDelayScheduler::worker_thread_func() {
+    WorkerState state;
     while (_running) {
-        // 快速读取配置并复制到本地变量
-        RocketMQDelaySchedulerConfig local_cfg;
+        std::chrono::milliseconds wait = run_once(&state);
+        if (wait.count() > 0) {
+            wait_for(wait);
+        }
+    }
+    discard_prefetch(&state);
+}
 
-        {
-            butil::DoublyBufferedData<RocketMQDelaySchedulerConfig>::ScopedPtr
-                cfg_ptr;
-            if (_cfg.Read(&cfg_ptr)) {
-                SPDLOG_ERROR(
-                    "Failed to read configuration for RocketMQDelayScheduler");
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                continue;
-            }
+void RocketMQDelayScheduler::schedule_worker_task(
+    const std::shared_ptr<WorkerState>& state, std::chrono::milliseconds delay,
+    uint64_t seq) {
+    auto task = [this, state] {
+        if (!_running) {
+            discard_prefetch(state.get());
+            return;
+        }
 
-            // 立即复制配置到本地，最小化持有读锁的时间
-            local_cfg = *cfg_ptr;
-        }    // ScopedPtr 在这里析构，立即释放读锁
+        uint64_t seq = wake_seq();
+        std::chrono::milliseconds wait = run_once(state.get());
+        if (_running) {
+            schedule_worker_task(state, wait, seq);
+        } else {
+            discard_prefetch(state.get());
+        }
+    };
 
-        short current_time = get_current_time();
+    if (!_executor->submit_after(_executor_group, delay, std::move(task))) {
+        return;
+    }
 
-        bool hit_flag = false;
-        std::shared_ptr<IRateLimiter> current_rate_limiter;
-        for (const auto& window : local_cfg.time_windows) {
-            if (window.enable && current_time >= window.start &&
-                current_time <= window.end) {
-                hit_flag = true;
-                current_rate_limiter = window.rate_limiter;
-                break;
+    // 定时任务登记之前发生的唤醒不会触发该任务，补一次唤醒
+    if (delay.count() > 0 && wake_seq() != seq) {
+        _executor->wake(_executor_group);
+    }
+}
+
+std::chrono::milliseconds RocketMQDelayScheduler::run_once(WorkerState* state) {
+    if (_cfg.refresh(&state->cfg, &state->cfg_version)) {
+        // 旧快照中的窗口可能已被释放
+        state->window_stale = true;
+    }
+
+    if (!state->cfg) {
+        SPDLOG_ERROR("Failed to read configuration for RocketMQDelayScheduler");
+        return std::chrono::seconds(1);
+    }
+
+    const RocketMQDelaySchedulerConfig& local_cfg = *state->cfg;
+
+    _metrics.forward_latency.maybe_log_summary(
+        std::chrono::seconds(local_cfg.latency_summary_interval_seconds));
+
+    // 延时交给 broker，不再等待时间窗口
+    if (local_cfg.schedule_mode ==
+        RocketMQDelaySchedulerConfig::ScheduleMode::BROKER_DELAY) {
+        return forward_with_delivery_plan(local_cfg);
+    }
+
+    const RocketMQDelaySchedulerConfig::TimeWindow* current_window =
+        find_active_window(local_cfg, state->cfg_version);
+
+    if (state->window_stale || current_window != state->last_window) {
+        state->window_stale = false;
+        state->last_window = current_window;
+        state->window_latency =
+            current_window ? _metrics.forward_latency.get(current_window->id)
+                           : nullptr;
+        _metrics.active_window.set_value(
+            current_window ? current_window->id : std::string());
+    }
+
+    // 窗口外等待时钟线程在下一个窗口开始时唤醒
+    if (!current_window) {
+        return std::chrono::seconds(local_cfg.scheduler_interval_seconds);
+    }
+
+    const std::shared_ptr<IRateLimiter>& current_rate_limiter =
+        current_window->rate_limiter;
+
+    // 按积压和窗口剩余时间调整限流速率，使积压在窗口结束前恰好清空
+    double target_rate = 0.0;
+    if (current_rate_limiter &&
+        _pacer.update(current_window->id,
+                      window_end_second(current_window->end) -
+                          seconds_of_day(),
+                      &target_rate) &&
+        !current_rate_limiter->set_rate(target_rate)) {
+        SPDLOG_WARN("Rate limiter of time window '{}' does not support pacing",
+                    current_window->id);
+    }
+
+    // 熔断期间不拉取无法投递的消息，半开时只拉取探测名额内的消息
+    std::size_t batch_limit =
+        _batch_tuner.batch_limit(local_cfg.buffer_consumer_batch_size);
+    std::chrono::milliseconds breaker_retry_after(0);
+    std::size_t admitted =
+        _circuit_breaker.admit(batch_limit, &breaker_retry_after);
+    if (admitted == 0) {
+        return breaker_retry_after;
+    }
+
+    // 按限流器授予的令牌数决定本次拉取的消息数，
+    // 使配置的速率即为实际转发速率
+    std::size_t batch_size = admitted;
+    if (current_rate_limiter) {
+        // 优先使用上一批次转发期间预取的令牌，窗口切换后预取结果作废，
+        // 作废的令牌归还给原来的限流器
+        std::future<PermitResult> pending;
+        if (state->prefetch_permits.valid() &&
+            state->prefetch_cfg_version == state->cfg_version &&
+            state->prefetch_limiter == current_rate_limiter) {
+            pending = std::move(state->prefetch_permits);
+            state->prefetch_limiter.reset();
+        } else {
+            discard_prefetch(state);
+            if (current_rate_limiter->is_async()) {
+                pending =
+                    request_permits(current_rate_limiter.get(), batch_size);
             }
         }
 
-        if (!hit_flag) {
-            std::this_thread::sleep_for(
-                std::chrono::seconds(local_cfg.scheduler_interval_seconds));
-            continue;
+        PermitResult permits{0, std::chrono::milliseconds(0)};
+        if (pending.valid()) {
+            // 分布式限流器的结果尚未返回时阻塞等待，期间执行器由备用线程顶替
+            if (pending.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready) {
+                WorkStealingExecutor::BlockingScope blocking;
+                pending.wait();
+            }
+            permits = pending.get();
+        } else {
+            permits = acquire_permits(current_rate_limiter.get(), batch_size);
+        }
+        batch_size = std::min(permits.granted, admitted);
+        release_permits(current_rate_limiter.get(),
+                        permits.granted - batch_size);
+        // 等到下一个令牌生成，窗口切换或配置更新时提前唤醒
+        if (batch_size == 0) {
+            _circuit_breaker.release(admitted);
+            return permits.retry_after.count() > 0 ? permits.retry_after
+                                                   : kDefaultRetryAfter;
         }
+    } else {
+        discard_prefetch(state);
+    }
 
-        if (current_rate_limiter) {
-            if (!current_rate_limiter->is_allowed()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                continue;
-            }
+    // 优先重放落盘的消息，重放占用本批次的令牌
+    // 重放是同步发送，返回时重放占用的令牌已经用完
+    std::size_t replayed = replay_spilled(local_cfg, batch_size);
+    release_permits(current_rate_limiter.get(), replayed);
+    batch_size -= replayed;
+    if (batch_size == 0) {
+        _circuit_breaker.release(admitted - replayed);
+        return std::chrono::milliseconds(0);
+    }
+
+    std::vector<rocketmq::MessageConstSharedPtr>& messages = state->messages;
+    messages.clear();
+    if (!receive_messages(local_cfg, batch_size, &messages)) {
+        release_permits(current_rate_limiter.get(), batch_size);
+        _circuit_breaker.release(admitted - replayed);
+        return std::chrono::seconds(local_cfg.scheduler_interval_seconds);
+    }
+    release_permits(current_rate_limiter.get(),
+                    batch_size - messages.size());
+    _circuit_breaker.release(admitted - replayed - messages.size());
+
+    _pacer.on_receive(batch_size, messages);
+
+    // receive() 本身是长轮询，空结果时不需要额外等待
+    if (messages.empty()) {
+        return std::chrono::milliseconds(0);
+    }
+
+    // 并发型限流器的名额随每条消息的转发上下文归还
+    bool lease_permits =
+        current_rate_limiter && current_rate_limiter->needs_release();
+
+    // 在转发本批次消息的同时异步获取下一批次的令牌。并发型限流器的名额
+    // 要等本批次发送结束才归还，预取只会占住名额，因此不预取；本地限流器
+    // 同步获取几乎没有开销，提前获取反而提前消耗令牌，同样不预取
+    if (current_rate_limiter && current_rate_limiter->is_async() &&
+        !lease_permits) {
+        state->prefetch_limiter = current_rate_limiter;
+        state->prefetch_cfg_version = state->cfg_version;
+        state->prefetch_permits =
+            request_permits(current_rate_limiter.get(), batch_limit);
+    }
+
+    ForwardContext ctx{{}, butil::cpuwide_time_us(), state->window_latency,
+                       current_rate_limiter.get()};
+    for (const auto& message : messages) {
+        if (lease_permits) {
+            ctx.permit = std::make_shared<PermitLease>(current_rate_limiter);
         }
+        forward_message(local_cfg, message, ctx);
+    }
+    _batch_tuner.record(messages.size(),
+                        butil::cpuwide_time_us() - ctx.received_us);
 
-        std::vector<rocketmq::MessageConstSharedPtr> messages;
-        std::error_code ec;
-        local_cfg.buffer_mq_consumer->receive(
-            local_cfg.buffer_consumer_batch_size,
-            std::chrono::seconds(local_cfg.buffer_consumer_invisible_duration),
-            ec, messages);
+    return std::chrono::milliseconds(0);
+}
 
-        if (ec) {
-            SPDLOG_ERROR("Failed to receive messages from buffer MQ: {}",
-                         ec.message());
-            std::this_thread::sleep_for(
-                std::chrono::seconds(local_cfg.scheduler_interval_seconds));
-            continue;
+void RocketMQDelayScheduler::clock_thread_func() {
+    std::shared_ptr<const RocketMQDelaySchedulerConfig> cfg;
+    uint64_t cfg_version = 0;
+
+    // 持锁检查配置版本和停止标志，避免错过 notify_clock 的唤醒
+    std::unique_lock<std::mutex> lock(_clock_mtx);
+    while (_running) {
+        _cfg.refresh(&cfg, &cfg_version);
+
+        auto now = std::chrono::system_clock::now();
+        std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+        std::tm local_tm;
+        localtime_r(&now_c, &local_tm);
+        int32_t second_of_day =
+            local_tm.tm_hour * 3600 + local_tm.tm_min * 60 + local_tm.tm_sec;
+        int64_t midnight_ms =
+            (static_cast<int64_t>(now_c) - second_of_day) * 1000;
+
+        int32_t next_transition = WindowSchedule::kSecondsPerDay;
+        int32_t window = -1;
+        if (cfg) {
+            window = cfg->schedule.lookup(second_of_day, &next_transition);
         }
 
-        if (messages.empty()) {
-            std::this_thread::sleep_for(
-                std::chrono::seconds(local_cfg.scheduler_interval_seconds));
-            continue;
+        _local_midnight_ms.store(midnight_ms, std::memory_order_relaxed);
+        uint64_t active = pack_active_window(cfg_version, window);
+        if (_active_window.exchange(active, std::memory_order_acq_rel) !=
+            active) {
+            // 窗口切换，唤醒在窗口外或等待令牌的工作线程
+            wake_workers();
         }
 
-        for (const auto& message : messages) {
-            auto new_message = rocketmq::Message::newBuilder()
-                                   .withTopic(local_cfg.target_producer_topic)
-                                   .withTag(message->tag())
-                                   .withKeys(message->keys())
-                                   .withBody(message->body())
-                                   .build();
+        // 休眠到下一次切换（零点也是一次切换），最长一分钟以校正系统时间的调整
+        auto wake_at = std::min(
+            std::chrono::system_clock::time_point(std::chrono::milliseconds(
+                midnight_ms + static_cast<int64_t>(next_transition) * 1000)),
+            now + std::chrono::minutes(1));
+        _clock_cv.wait_until(lock, wake_at);
+    }
+}
 
-            std::error_code send_ec;
-            rocketmq::SendReceipt send_receipt =
-                local_cfg.target_mq_producer->send(std::move(new_message),
-                                                   send_ec);
+void RocketMQDelayScheduler::wait_for(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(_wake_mtx);
+    uint64_t wake_seq = _wake_seq;
+    _wake_cv.wait_until(lock, deadline, [this, wake_seq] {
+        return !_running || _wake_seq != wake_seq;
+    });
+}
+
+void RocketMQDelayScheduler::wake_workers() {
+    {
+        std::lock_guard<std::mutex> lock(_wake_mtx);
+        ++_wake_seq;
+    }
+    _wake_cv.notify_all();
+
+    if (_executor_group) {
+        _executor->wake(_executor_group);
+    }
+}
 
+uint64_t RocketMQDelayScheduler::wake_seq() {
+    std::lock_guard<std::mutex> lock(_wake_mtx);
+    return _wake_seq;
+}
+
+void RocketMQDelayScheduler::notify_clock() {
+    {
+        // 时钟线程在持锁期间检查配置版本和停止标志，加锁后通知不会丢失
+        std::lock_guard<std::mutex> lock(_clock_mtx);
+    }
+    _clock_cv.notify_all();
+}
+
+const RocketMQDelaySchedulerConfig::TimeWindow*
+RocketMQDelayScheduler::find_active_window(
+    const RocketMQDelaySchedulerConfig& cfg, uint64_t cfg_version) const {
+    uint64_t active = _active_window.load(std::memory_order_acquire);
+
+    int32_t window = -1;
+    if ((active >> 32) == (cfg_version & 0xffffffff)) {
+        window = static_cast<int32_t>(active & 0xffffffff) - 1;
+    } else {
+        // 时钟线程尚未处理新的配置
+        window = cfg.schedule.lookup(seconds_of_day(), nullptr);
+    }
+
+    return window >= 0 ? &cfg.time_windows[window] : nullptr;
+}
+
+int32_t RocketMQDelayScheduler::seconds_of_day() const {
+    int64_t midnight_ms = _local_midnight_ms.load(std::memory_order_relaxed);
+    int64_t elapsed_ms = now_ms() - midnight_ms;
+    if (midnight_ms > 0 && elapsed_ms >= 0 &&
+        elapsed_ms < WindowSchedule::kSecondsPerDay * 1000LL) {
+        return static_cast<int32_t>(elapsed_ms / 1000);
+    }
+
+    return local_seconds_of_day();
+}
+
+std::chrono::milliseconds
+RocketMQDelayScheduler::forward_with_delivery_plan(
+    const RocketMQDelaySchedulerConfig& cfg) {
+    // 已排定的投递时间超出最大提前量时暂停消费，等待时间推进
+    int64_t max_ahead_ms =
+        static_cast<int64_t>(cfg.broker_delay_max_ahead_seconds) * 1000;
+    int64_t ahead_ms = _delivery_planner.schedule_ahead_ms(now_ms());
+    if (ahead_ms >= max_ahead_ms) {
+        return std::chrono::milliseconds(ahead_ms - max_ahead_ms + 1);
+    }
+
+    std::chrono::milliseconds breaker_retry_after(0);
+    std::size_t admitted = _circuit_breaker.admit(
+        _batch_tuner.batch_limit(cfg.buffer_consumer_batch_size),
+        &breaker_retry_after);
+    if (admitted == 0) {
+        return breaker_retry_after;
+    }
+
+    // 落盘的定时消息带有原投递时间，不再重新规划
+    std::size_t replayed = replay_spilled(cfg, admitted);
+    if (replayed > 0) {
+        _circuit_breaker.release(admitted - replayed);
+        return std::chrono::milliseconds(0);
+    }
+
+    std::vector<rocketmq::MessageConstSharedPtr> messages;
+    if (!receive_messages(cfg, admitted, &messages)) {
+        _circuit_breaker.release(admitted);
+        return std::chrono::seconds(cfg.scheduler_interval_seconds);
+    }
+
+    if (messages.empty()) {
+        _circuit_breaker.release(admitted);
+        return std::chrono::milliseconds(0);
+    }
+
+    std::vector<int64_t> slots;
+    std::size_t allocated =
+        _delivery_planner.allocate(messages.size(), now_ms(), &slots);
+    _circuit_breaker.release(admitted - allocated);
+
+    ForwardContext ctx{{}, butil::cpuwide_time_us(),
+                       _metrics.forward_latency.get("broker_delay")};
+    for (std::size_t i = 0; i < allocated; ++i) {
+        ctx.deliver_at = std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(slots[i]));
+        forward_message(cfg, messages[i], ctx);
+    }
+    _batch_tuner.record(allocated, butil::cpuwide_time_us() - ctx.received_us);
+
+    // 未分配到投递时间的消息立即释放，在提前量重新可用时再次投递，
+    // 而不是等到整个不可见时间结束
+    if (allocated == messages.size()) {
+        return std::chrono::milliseconds(0);
+    }
+    std::chrono::milliseconds retry_after(std::max<int64_t>(
+        1, _delivery_planner.schedule_ahead_ms(now_ms()) - max_ahead_ms + 1));
+    for (std::size_t i = allocated; i < messages.size(); ++i) {
+        _callback_state->release_message(cfg.buffer_mq_consumer, messages[i],
+                                         retry_after);
+    }
+    return retry_after;
+}
+
+void RocketMQDelayScheduler::forward_message(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    // 停止后超过排空期限，本批次剩余的消息释放给其他实例
+    // 未发送的消息不会产生结果，归还其占用的熔断探测名额
+    if (drain_expired()) {
+        _circuit_breaker.release(1);
+        _callback_state->release_message(
+            cfg.buffer_mq_consumer, message,
+            std::chrono::milliseconds(cfg.drain_release_invisible_ms));
+        return;
+    }
+
+    // 本批次拉取后熔断器打开，剩余消息不再发送
+    if (!_circuit_breaker.allow()) {
+        divert_message(cfg, message, ctx);
+        return;
+    }
+
+    // 同组前面的消息发送失败后，在它重新投递之前不发送本条，交还 broker
+    // 在它之后重新投递；失败的消息本身转入死信主题时同样解除隔离
+    if (cfg.forward_mode ==
+            RocketMQDelaySchedulerConfig::ForwardMode::ORDERED &&
+        !message->group().empty() && !pass_group_fence(cfg, *message)) {
+        _circuit_breaker.release(1);
+        _callback_state->release_message(
+            cfg.buffer_mq_consumer, message,
+            std::chrono::milliseconds(cfg.ordered_max_retry_backoff_ms));
+        return;
+    }
+
+    // 反复发送失败的消息不再占用目标主题的发送
+    if (is_dead_letter(cfg, *message)) {
+        forward_dead_letter(cfg, message, ctx);
+        return;
+    }
+
+    switch (cfg.forward_mode) {
+        case RocketMQDelaySchedulerConfig::ForwardMode::ASYNC:
+            forward_message_async(cfg, message, ctx);
+            break;
+        case RocketMQDelaySchedulerConfig::ForwardMode::PIPELINE:
+            forward_message_pipeline(cfg, message, ctx);
+            break;
+        case RocketMQDelaySchedulerConfig::ForwardMode::ORDERED:
+            forward_message_ordered(cfg, message, ctx);
+            break;
+        default:
+            forward_message_sync(cfg, message, ctx);
+            break;
+    }
+}
+
+std::size_t RocketMQDelayScheduler::replay_spilled(
+    const RocketMQDelaySchedulerConfig& cfg, std::size_t max) {
+    std::vector<SpillQueue::Record> records;
+    if (!cfg.spill_queue || !cfg.spill_queue->begin_replay(max, &records)) {
+        return 0;
+    }
+
+    // 逐条同步发送，遇到失败即停止，保证只删除发送成功的前缀
+    WorkStealingExecutor::BlockingScope blocking;
+    std::size_t replayed = 0;
+    for (auto& record : records) {
+        if (!record.corrupted) {
+            std::error_code send_ec;
+            int64_t send_start_us = butil::cpuwide_time_us();
+            cfg.target_mq_producer->send(build_spilled_message(cfg, &record),
+                                         send_ec);
+            int64_t send_latency_us = butil::cpuwide_time_us() - send_start_us;
+            _metrics.send_latency << send_latency_us;
+            _circuit_breaker.record(!send_ec, send_latency_us);
             if (send_ec) {
-                SPDLOG_ERROR("Failed to send message to target MQ: {}",
-                             send_ec.message());
-                continue;
-            } else {
-                SPDLOG_INFO(
-                    "Successfully sent message to topic {}. Message ID: {}",
-                    local_cfg.target_producer_topic, send_receipt.message_id);
+                SPDLOG_WARN("Failed to replay spilled message: {}",
+                            send_ec.message());
+                _metrics.send_failures << 1;
+                break;
+            }
+            _metrics.forwarded << 1;
+        } else {
+            // 丢弃的损坏记录没有发送结果，归还占用的熔断探测名额
+            _circuit_breaker.release(1);
+        }
+        ++replayed;
+    }
+
+    cfg.spill_queue->end_replay(records, replayed);
+    return replayed;
+}
+
+void RocketMQDelayScheduler::CallbackState::record_send_result(
+    const ForwardContext& ctx, bool success, int64_t latency_us) {
+    metrics.send_latency << latency_us;
+    circuit_breaker.record(success, latency_us);
+    // 只有并发型限流器需要反馈，其名额保证限流器仍然存活
+    if (ctx.permit) {
+        ctx.limiter->on_complete(latency_us, success);
+    }
+}
+
+void RocketMQDelayScheduler::CallbackState::record_forwarded(
+    const ForwardContext& ctx, const rocketmq::Message& message) {
+    metrics.forwarded << 1;
+
+    if (ctx.latency) {
+        ctx.latency->born_to_forward_ms.record(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now() - message.bornTime())
+                .count());
+        ctx.latency->receive_to_send_us.record(butil::cpuwide_time_us() -
+                                               ctx.received_us);
+    }
+}
+
+std::future<RocketMQDelayScheduler::PermitResult>
+RocketMQDelayScheduler::request_permits(IRateLimiter* limiter,
+                                        std::size_t permits) {
+    auto promise = std::make_shared<std::promise<PermitResult>>();
+    std::future<PermitResult> future = promise->get_future();
+    int64_t start_us = butil::cpuwide_time_us();
+
+    // 回调可能在 brpc 的 bthread 中晚于 stop() 完成，计入在途数由 stop() 等待
+    _callback_state->track_inflight();
+    auto state = _callback_state;
+    limiter->async_try_acquire(
+        permits, [state, promise, permits, start_us](
+                     std::size_t granted,
+                     std::chrono::milliseconds retry_after) {
+            state->record_permits(permits, granted, start_us);
+            promise->set_value(PermitResult{granted, retry_after});
+            state->release_inflight_slot();
+        });
+
+    return future;
+}
+
+void RocketMQDelayScheduler::discard_prefetch(WorkerState* state) {
+    if (state->prefetch_permits.valid()) {
+        // 只在窗口切换、配置更新和停止时发生，等待时长受限流检查超时限制
+        if (state->prefetch_permits.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+            WorkStealingExecutor::BlockingScope blocking;
+            state->prefetch_permits.wait();
+        }
+        release_permits(state->prefetch_limiter.get(),
+                        state->prefetch_permits.get().granted);
+    }
+    state->prefetch_limiter.reset();
+}
+
+RocketMQDelayScheduler::PermitResult RocketMQDelayScheduler::acquire_permits(
+    IRateLimiter* limiter, std::size_t permits) {
+    int64_t start_us = butil::cpuwide_time_us();
+    PermitResult result{0, std::chrono::milliseconds(0)};
+    result.granted = limiter->try_acquire(permits, &result.retry_after);
+    _callback_state->record_permits(permits, result.granted, start_us);
+    return result;
+}
+
+void RocketMQDelayScheduler::CallbackState::record_permits(
+    std::size_t requested, std::size_t granted, int64_t start_us) {
+    metrics.limiter_latency << butil::cpuwide_time_us() - start_us;
+    metrics.limiter_granted << static_cast<int64_t>(granted);
+    metrics.limiter_denials
+        << static_cast<int64_t>(requested - std::min(requested, granted));
+}
+
+bool RocketMQDelayScheduler::receive_messages(
+    const RocketMQDelaySchedulerConfig& cfg, std::size_t batch_size,
+    std::vector<rocketmq::MessageConstSharedPtr>* messages) {
+    // 自适应模式下不可见时长覆盖本批次的预计转发耗时
+    std::chrono::milliseconds invisible_duration =
+        _batch_tuner.invisible_duration(
+            batch_size,
+            std::chrono::seconds(cfg.buffer_consumer_invisible_duration));
+
+    std::error_code ec;
+    int64_t start_us = butil::cpuwide_time_us();
+    {
+        // 长轮询最长阻塞 buffer_consumer_await_duration
+        WorkStealingExecutor::BlockingScope blocking;
+        cfg.buffer_mq_consumer->receive(batch_size, invisible_duration, ec,
+                                        *messages);
+    }
+    _metrics.receive_latency << butil::cpuwide_time_us() - start_us;
+
+    if (ec) {
+        SPDLOG_ERROR("Failed to receive messages from buffer MQ: {}",
+                     ec.message());
+        return false;
+    }
+
+    _metrics.received << static_cast<int64_t>(messages->size());
+
+    // 长轮询期间调度器已停止，拉取到的消息直接释放
+    if (!_running) {
+        for (const auto& message : *messages) {
+            _callback_state->release_message(
+                cfg.buffer_mq_consumer, message,
+                std::chrono::milliseconds(cfg.drain_release_invisible_ms));
+        }
+        messages->clear();
+    }
+    return true;
+}
+
+void RocketMQDelayScheduler::forward_message_sync(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    // 同步发送和确认都要等待网络往返
+    WorkStealingExecutor::BlockingScope blocking;
+    std::error_code send_ec;
+    int64_t send_start_us = butil::cpuwide_time_us();
+    rocketmq::SendReceipt send_receipt = cfg.target_mq_producer->send(
+        build_target_message(cfg, message, ctx.deliver_at), send_ec);
+    _callback_state->record_send_result(
+        ctx, !send_ec, butil::cpuwide_time_us() - send_start_us);
+
+    if (send_ec) {
+        SPDLOG_ERROR("Failed to send message to target MQ: {}",
+                     send_ec.message());
+        _metrics.send_failures << 1;
+        // 落盘成功后按已转发处理，确认缓冲队列中的原消息
+        if (!spill_message(spill_queue_of(cfg).get(), send_receipt)) {
+            _callback_state->retry_later(cfg.buffer_mq_consumer, message,
+                                         retry_backoff_of(cfg, *message));
+            return;
+        }
+    } else {
+        _callback_state->record_forwarded(ctx, *message);
+        SPDLOG_INFO("Successfully sent message to topic {}. Message ID: {}",
+                    cfg.target_producer_topic, send_receipt.message_id);
+    }
+
+    std::error_code ack_ec;
+    int64_t ack_start_us = butil::cpuwide_time_us();
+    cfg.buffer_mq_consumer->ack(*message, ack_ec);
+    _metrics.ack_latency << butil::cpuwide_time_us() - ack_start_us;
+    if (ack_ec) {
+        SPDLOG_ERROR("Failed to ack message in buffer MQ: {}",
+                     ack_ec.message());
+        _metrics.ack_failures << 1;
+    }
+}
+
+void RocketMQDelayScheduler::forward_message_async(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    if (!acquire_inflight_slot(cfg.max_inflight_messages)) {
+        _circuit_breaker.release(1);
+        _callback_state->release_message(
+            cfg.buffer_mq_consumer, message,
+            std::chrono::milliseconds(cfg.drain_release_invisible_ms));
+        return;
+    }
+
+    cfg.target_mq_producer->send(
+        build_target_message(cfg, message, ctx.deliver_at),
+        make_send_callback(cfg, message, ctx));
+}
+
+void RocketMQDelayScheduler::forward_message_ordered(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    // 不属于任何消息组的消息没有顺序要求，不占用顺序通道
+    if (message->group().empty()) {
+        forward_message_async(cfg, message, ctx);
+        return;
+    }
+
+    if (!acquire_inflight_slot(cfg.max_inflight_messages)) {
+        _circuit_breaker.release(1);
+        _callback_state->release_message(
+            cfg.buffer_mq_consumer, message,
+            std::chrono::milliseconds(cfg.drain_release_invisible_ms));
+        return;
+    }
+
+    // FifoProducer 按消息组哈希到固定通道，通道内逐条发送，
+    // 前一条发送成功后才发送下一条，失败的消息在通道头部退避重试，
+    // 重试次数用完后回调中按发送失败处理
+    cfg.target_fifo_producer->send(
+        build_target_message(cfg, message, ctx.deliver_at),
+        make_send_callback(cfg, message, ctx));
+}
+
+void RocketMQDelayScheduler::CallbackState::fence_group(
+    const rocketmq::Message& message, int64_t ttl_ms) {
+    int64_t now = steady_now_ms();
+    std::lock_guard<std::mutex> lock(fence_mtx);
+    // 到期后不再出现的消息组不会在 pass_group_fence() 中解除，顺带清理
+    for (auto it = group_fences.begin(); it != group_fences.end();) {
+        it = now >= it->second.expire_ms ? group_fences.erase(it)
+                                         : std::next(it);
+    }
+    group_fences[message.group()] = GroupFence{message.id(), now + ttl_ms};
+    SPDLOG_WARN("Message group {} fenced until message {} is redelivered",
+                message.group(), message.id());
+}
+
+bool RocketMQDelayScheduler::pass_group_fence(
+    const RocketMQDelaySchedulerConfig& cfg, const rocketmq::Message& message) {
+    std::lock_guard<std::mutex> lock(_callback_state->fence_mtx);
+    auto it = _callback_state->group_fences.find(message.group());
+    if (it == _callback_state->group_fences.end()) {
+        return true;
+    }
+
+    if (it->second.message_id != message.id() &&
+        steady_now_ms() < it->second.expire_ms) {
+        return false;
+    }
+
+    _callback_state->group_fences.erase(it);
+    if (cfg.target_fifo_producer) {
+        cfg.target_fifo_producer->resume(message.group());
+    }
+    return true;
+}
+
+rocketmq::SendCallback RocketMQDelayScheduler::make_send_callback(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    // 回调中持有 consumer 和 message 的引用，避免热加载替换配置后被释放
+    auto consumer = cfg.buffer_mq_consumer;
+    // 顺序消息落盘后会被同组的后续消息越过，发送失败时交给缓冲队列重新投递
+    bool grouped =
+        cfg.forward_mode ==
+            RocketMQDelaySchedulerConfig::ForwardMode::ORDERED &&
+        !message->group().empty();
+    auto spill_queue = grouped ? nullptr : spill_queue_of(cfg);
+    std::string target_topic = cfg.target_producer_topic;
+    std::chrono::milliseconds retry_backoff = retry_backoff_of(cfg, *message);
+    std::chrono::milliseconds fenced_release(cfg.ordered_max_retry_backoff_ms);
+
+    // 失败的消息最晚在不可见时间结束后重新投递，之后仍未回到本实例
+    // 说明已由其他实例处理，隔离到期解除
+    int64_t fence_ttl_ms = -1;
+    if (grouped) {
+        std::size_t invisible_seconds =
+            cfg.adaptive_batch.enable
+                ? std::max(cfg.buffer_consumer_invisible_duration,
+                           cfg.adaptive_batch.max_invisible_seconds)
+                : cfg.buffer_consumer_invisible_duration;
+        fence_ttl_ms = retry_backoff.count() +
+                       static_cast<int64_t>(invisible_seconds) * 1000 +
+                       kGroupFenceGraceMs;
+    }
+
+    int64_t send_start_us = butil::cpuwide_time_us();
+
+    // 回调只持有回调状态，stop() 等待超时后迟到的回调仍可安全访问
+    auto state = _callback_state;
+    return [state, consumer, spill_queue, message, target_topic, retry_backoff,
+            fenced_release, fence_ttl_ms, send_start_us,
+            ctx](const std::error_code& send_ec,
+                 const rocketmq::SendReceipt& send_receipt) {
+        // 同组前面的消息发送失败，本条没有发送，交还 broker 在其后重新投递
+        if (send_ec == rocketmq::ErrorCode::FifoGroupFenced) {
+            state->circuit_breaker.release(1);
+            state->release_message(consumer, message, fenced_release);
+            state->release_inflight_slot();
+            return;
+        }
+
+        state->record_send_result(ctx, !send_ec,
+                                  butil::cpuwide_time_us() - send_start_us);
+        if (send_ec) {
+            SPDLOG_ERROR("Failed to send message to target MQ: {}",
+                         send_ec.message());
+            state->metrics.send_failures << 1;
+            // 先隔离再交还：该消息重新投递时隔离已经生效
+            if (fence_ttl_ms >= 0) {
+                state->fence_group(*message, fence_ttl_ms);
+            }
+            if (!spill_message(spill_queue.get(), send_receipt)) {
+                state->retry_later(consumer, message, retry_backoff);
+                state->release_inflight_slot();
+                return;
             }
+        } else {
+            state->record_forwarded(ctx, *message);
+            SPDLOG_INFO(
+                "Successfully sent message to topic {}. Message ID: {}",
+                target_topic, send_receipt.message_id);
+        }
 
-            std::string receipt_handle = message->extension().receipt_handle;
-            std::error_code ack_ec;
-            local_cfg.buffer_mq_consumer->ack(*message, ack_ec);
+        int64_t ack_start_us = butil::cpuwide_time_us();
+        consumer->asyncAck(*message, [state, consumer, message, ack_start_us](
+                                         const std::error_code& ack_ec) {
+            state->metrics.ack_latency
+                << butil::cpuwide_time_us() - ack_start_us;
             if (ack_ec) {
                 SPDLOG_ERROR("Failed to ack message in buffer MQ: {}",
                              ack_ec.message());
+                state->metrics.ack_failures << 1;
             }
+            state->release_inflight_slot();
+        });
+    };
+}
+
+void RocketMQDelayScheduler::forward_message_pipeline(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    // 启动时未使用流水线模式（热加载切换而来）时退化为同步转发
+    if (!_send_queue) {
+        forward_message_sync(cfg, message, ctx);
+        return;
+    }
+
+    PipelineItem item{cfg.buffer_mq_consumer, cfg.target_mq_producer, message,
+                      build_target_message(cfg, message, ctx.deliver_at),
+                      spill_queue_of(cfg), retry_backoff_of(cfg, *message),
+                      ctx};
+
+    if (_send_queue->try_push(std::move(item))) {
+        return;
+    }
+
+    // 发送队列已满说明下游处理不过来，阻塞拉取线程形成背压
+    WorkStealingExecutor::BlockingScope blocking;
+    if (!_send_queue->push(
+            std::move(item), [this] { return drain_expired(); },
+            [this] { return drain_deadline(); })) {
+        _circuit_breaker.release(1);
+        _callback_state->release_message(
+            item.consumer, item.message,
+            std::chrono::milliseconds(cfg.drain_release_invisible_ms));
+    }
+}
+
+void RocketMQDelayScheduler::pipeline_send_thread_func() {
+    // 停止后在排空期限内继续发送，直到拉取阶段退出且发送队列为空；
+    // 期限过后队列中剩余的消息由 stop() 释放
+    while (!drain_expired()) {
+        // 每轮使用新的对象，处理完的消息不再持有并发限流器的名额
+        PipelineItem item;
+        // 拉取阶段退出后发送队列不会再有新消息
+        if (!_send_queue->pop(
+                item,
+                [this] {
+                    return drain_expired() || (!_running && _workers_stopped);
+                },
+                [this] { return drain_deadline(); })) {
+            break;
+        }
+
+        // 入队后熔断器打开的消息不再发送，可落盘时落盘后确认，
+        // 否则按退避时间交还 broker，不必等到整个不可见时间结束
+        if (!_circuit_breaker.allow()) {
+            _circuit_breaker.release(1);
+            if (!item.spill_queue || !item.spill_queue->append(*item.target)) {
+                _callback_state->retry_later(item.consumer, item.message,
+                                             item.retry_backoff);
+                continue;
+            }
+        } else if (!send_pipeline_item(&item)) {
+            continue;
+        }
+
+        // 确认队列已满时等待，停止期间也不丢弃已发送消息的确认
+        _ack_queue->push(
+            std::move(item), [] { return false; },
+            [] { return std::chrono::steady_clock::time_point::max(); });
+    }
+
+    // 最后一个发送线程退出后，等待中的确认线程需要重新检查退出条件
+    --_active_send_threads;
+    _ack_queue->notify_all();
+}
+
+bool RocketMQDelayScheduler::send_pipeline_item(PipelineItem* item) {
+    std::error_code send_ec;
+    int64_t send_start_us = butil::cpuwide_time_us();
+    rocketmq::SendReceipt send_receipt =
+        item->producer->send(std::move(item->target), send_ec);
+    _callback_state->record_send_result(
+        item->ctx, !send_ec, butil::cpuwide_time_us() - send_start_us);
+    if (send_ec) {
+        SPDLOG_ERROR("Failed to send message to target MQ: {}",
+                     send_ec.message());
+        _metrics.send_failures << 1;
+        if (!spill_message(item->spill_queue.get(), send_receipt)) {
+            _callback_state->retry_later(item->consumer, item->message,
+                                         item->retry_backoff);
+            return false;
         }
+        return true;
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    _callback_state->record_forwarded(item->ctx, *item->message);
+    SPDLOG_INFO("Successfully sent message. Message ID: {}",
+                send_receipt.message_id);
+    return true;
+}
+
+void RocketMQDelayScheduler::divert_message(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    WorkStealingExecutor::BlockingScope blocking;
+    // 未启用落盘时不确认，消息在不可见时间结束后被重新投递；
+    // 顺序消息落盘后会被同组的后续消息越过，同样留给 broker 重新投递
+    auto spill_queue = spill_queue_of(cfg);
+    if (!spill_queue ||
+        (cfg.forward_mode ==
+             RocketMQDelaySchedulerConfig::ForwardMode::ORDERED &&
+         !message->group().empty()) ||
+        !spill_queue->append(
+            *build_target_message(cfg, message, ctx.deliver_at))) {
+        return;
     }
+
+    std::error_code ack_ec;
+    int64_t ack_start_us = butil::cpuwide_time_us();
+    cfg.buffer_mq_consumer->ack(*message, ack_ec);
+    _metrics.ack_latency << butil::cpuwide_time_us() - ack_start_us;
+    if (ack_ec) {
+        SPDLOG_ERROR("Failed to ack message in buffer MQ: {}",
+                     ack_ec.message());
+        _metrics.ack_failures << 1;
+    }
+}
+
+void RocketMQDelayScheduler::CallbackState::retry_later(
+    const std::shared_ptr<rocketmq::SimpleConsumer>& consumer,
+    const rocketmq::MessageConstSharedPtr& message,
+    std::chrono::milliseconds backoff) {
+    if (backoff.count() <= 0) {
+        return;
+    }
+
+    // 缩短不可见时间，消息在 backoff 后被重新投递，delivery_attempt 加一
+    track_inflight();
+    std::string receipt_handle = message->extension().receipt_handle;
+    auto self = shared_from_this();
+    consumer->asyncChangeInvisibleDuration(
+        *message, receipt_handle, backoff,
+        [self, consumer, message](const std::error_code& ec,
+                                  std::string& /*receipt_handle*/) {
+            if (ec) {
+                SPDLOG_WARN("Failed to change invisible duration of message "
+                            "{}: {}",
+                            message->id(), ec.message());
+            } else {
+                self->metrics.retries << 1;
+            }
+            self->release_inflight_slot();
+        });
+}
+
+void RocketMQDelayScheduler::forward_dead_letter(
+    const RocketMQDelaySchedulerConfig& cfg,
+    const rocketmq::MessageConstSharedPtr& message,
+    const ForwardContext& ctx) {
+    WorkStealingExecutor::BlockingScope blocking;
+    uint16_t attempts = message->extension().delivery_attempt;
+
+    auto properties = message->properties();
+    properties[kDeliveryAttemptsProperty] = std::to_string(attempts);
+    properties.emplace(kOriginTopicProperty, message->topic());
+
+    // 死信主题为普通主题，不保留消息组
+    auto builder = rocketmq::Message::newBuilder();
+    builder.withTopic(cfg.retry.dead_letter_topic)
+        .forwardFrom(*message)
+        .withProperties(std::move(properties))
+        .withGroup(std::string());
+
+    std::error_code send_ec;
+    int64_t send_start_us = butil::cpuwide_time_us();
+    cfg.target_mq_producer->send(builder.build(), send_ec);
+    _callback_state->record_send_result(
+        ctx, !send_ec, butil::cpuwide_time_us() - send_start_us);
+    if (send_ec) {
+        SPDLOG_ERROR("Failed to send message {} to dead letter topic {}: {}",
+                     message->id(), cfg.retry.dead_letter_topic,
+                     send_ec.message());
+        _metrics.send_failures << 1;
+        _callback_state->retry_later(
+            cfg.buffer_mq_consumer, message,
+            std::chrono::milliseconds(cfg.retry.max_backoff_ms));
+        return;
+    }
+
+    SPDLOG_WARN("Message {} moved to dead letter topic {} after {} attempt(s)",
+                message->id(), cfg.retry.dead_letter_topic, attempts);
+    _metrics.dead_lettered << 1;
+
+    std::error_code ack_ec;
+    int64_t ack_start_us = butil::cpuwide_time_us();
+    cfg.buffer_mq_consumer->ack(*message, ack_ec);
+    _metrics.ack_latency << butil::cpuwide_time_us() - ack_start_us;
+    if (ack_ec) {
+        SPDLOG_ERROR("Failed to ack message in buffer MQ: {}",
+                     ack_ec.message());
+        _metrics.ack_failures << 1;
+    }
+}
+
+void RocketMQDelayScheduler::pipeline_ack_thread_func() {
+    while (true) {
+        PipelineItem item;
+        // 发送阶段全部退出后确认队列不会再有新消息
+        if (!_ack_queue->pop(
+                item,
+                [this] { return !_running && _active_send_threads == 0; },
+                [] { return std::chrono::steady_clock::time_point::max(); })) {
+            break;
+        }
+
+        std::error_code ack_ec;
+        int64_t ack_start_us = butil::cpuwide_time_us();
+        item.consumer->ack(*item.message, ack_ec);
+        _metrics.ack_latency << butil::cpuwide_time_us() - ack_start_us;
+        if (ack_ec) {
+            SPDLOG_ERROR("Failed to ack message in buffer MQ: {}",
+                         ack_ec.message());
+            _metrics.ack_failures << 1;
+        }
+    }
+}
+
+bool RocketMQDelayScheduler::acquire_inflight_slot(std::size_t max_inflight) {
+    // 只有名额用完需要等待时才进入阻塞区间
+    std::optional<WorkStealingExecutor::BlockingScope> blocking;
+    std::unique_lock<std::mutex> lock(_callback_state->inflight_mtx);
+    while (_callback_state->inflight_count >= max_inflight) {
+        if (!blocking) {
+            blocking.emplace();
+        }
+        if (_running) {
+            _callback_state->inflight_cv.wait(lock);
+            continue;
+        }
+
+        // 停止后只在排空期限内等待名额
+        auto deadline = std::chrono::steady_clock::time_point(
+            std::chrono::milliseconds(_drain_deadline_ms.load()));
+        if (_callback_state->inflight_cv.wait_until(lock, deadline) ==
+            std::cv_status::timeout) {
+            return false;
+        }
+    }
+
+    if (drain_expired()) {
+        return false;
+    }
+
+    ++_callback_state->inflight_count;
+    return true;
+}
+
+void RocketMQDelayScheduler::CallbackState::release_inflight_slot() {
+    // 持锁通知：解锁后 wait_inflight_drained() 可能看到计数归零并返回，
+    // 本状态随调度器一起被销毁，之后再访问条件变量即为释放后使用
+    std::lock_guard<std::mutex> lock(inflight_mtx);
+    --inflight_count;
+    inflight_cv.notify_all();
+}
+
+void RocketMQDelayScheduler::wait_inflight_drained() {
+    // broker 或限流服务无响应时回调可能迟迟不来，不能无限期阻塞停止流程
+    int64_t wait_ms =
+        std::max<int64_t>(_drain_deadline_ms.load() - steady_now_ms(), 0) +
+        kInflightGraceMs;
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+    CallbackState& state = *_callback_state;
+    std::unique_lock<std::mutex> lock(state.inflight_mtx);
+    if (!state.inflight_cv.wait_until(
+            lock, deadline, [&state] { return state.inflight_count == 0; })) {
+        SPDLOG_WARN("Scheduler {} stopped with {} in-flight request(s) "
+                    "outstanding, late callbacks keep its callback state "
+                    "alive",
+                    _name, state.inflight_count);
+    }
+}
+
+void RocketMQDelayScheduler::CallbackState::track_inflight() {
+    std::lock_guard<std::mutex> lock(inflight_mtx);
+    ++inflight_count;
+}
+
+bool RocketMQDelayScheduler::drain_expired() const {
+    return !_running && steady_now_ms() >= _drain_deadline_ms.load();
+}
+
+std::chrono::steady_clock::time_point RocketMQDelayScheduler::drain_deadline()
+    const {
+    if (_running) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return std::chrono::steady_clock::time_point(
+        std::chrono::milliseconds(_drain_deadline_ms.load()));
+}
+
+void RocketMQDelayScheduler::CallbackState::release_message(
+    const std::shared_ptr<rocketmq::SimpleConsumer>& consumer,
+    const rocketmq::MessageConstSharedPtr& message,
+    std::chrono::milliseconds invisible_duration) {
+    // 回调中引用了回调状态，计入在途数，stop() 等待其完成
+    track_inflight();
+    std::string receipt_handle = message->extension().receipt_handle;
+    auto self = shared_from_this();
+    consumer->asyncChangeInvisibleDuration(
+        *message, receipt_handle, invisible_duration,
+        [self, consumer, message](const std::error_code& ec,
+                                  std::string& /*receipt_handle*/) {
+            if (ec) {
+                SPDLOG_WARN("Failed to release message {}: {}", message->id(),
+                            ec.message());
+            } else {
+                self->metrics.released << 1;
+            }
+            self->release_inflight_slot();
+        });
 }
 
 void RocketMQDelayScheduler::reload_config() {
@@ -473,7 +2402,7 @@ void RocketMQDelayScheduler::reload_config() {
     }
 
     // 复用 init 方法重新加载配置
-    // 由于 init 使用 _cfg.Modify() 更新配置，是线程安全的
+    // init 通过 _cfg.publish() 发布新的配置快照，是线程安全的
     if (init(_name, _config_file)) {
         SPDLOG_INFO("Configuration reloaded successfully");
     } else {
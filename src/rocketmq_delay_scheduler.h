@@ -1,13 +1,27 @@
 #pragma once
 
+#include <condition_variable>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
-#include "butil/containers/doubly_buffered_data.h"
+#include "batch_tuner.h"
+#include "circuit_breaker.h"
+#include "deadline_pacer.h"
+#include "delivery_planner.h"
 #include "hot_loader.h"
 #include "iratelimiter.h"
 #include "ischeduler.h"
+#include "mpmc_queue.h"
+#include "scheduler_metrics.h"
+#include "spill_queue.h"
+#include "versioned_snapshot.h"
+#include "window_schedule.h"
+#include "work_stealing_executor.h"
 #include "rocketmq/ErrorCode.h"
+#include "rocketmq/FifoProducer.h"
 #include "rocketmq/Logger.h"
 #include "rocketmq/Message.h"
 #include "rocketmq/Producer.h"
@@ -19,9 +33,78 @@ namespace bmq {
 class RocketMQDelaySchedulerHotLoadTask;
 
 struct RocketMQDelaySchedulerConfig {
+    // 消息转发模式
+    enum class ForwardMode {
+        SYNC,        // 同步发送，发送成功后同步确认
+        ASYNC,       // 异步发送，发送回调中异步确认
+        PIPELINE,    // 拉取、发送、确认分别由独立的线程组通过队列衔接
+        ORDERED,     // 同一消息组的消息按到达顺序经固定通道依次发送
+    };
+
+    // 调度模式
+    enum class ScheduleMode {
+        WINDOW,          // 仅在时间窗口内按限流速率消费并转发
+        BROKER_DELAY,    // 持续消费，以定时消息的方式把延时交给 broker
+    };
+
+    // 并发拉取转发的任务数，使用共享执行器时为该调度器占用的线程数上限
     std::size_t worker_threads{std::thread::hardware_concurrency()};
+    double weight{1.0};    // 共享执行器线程不足时的相对份额
     std::size_t scheduler_interval_seconds;
 
+    ForwardMode forward_mode{ForwardMode::SYNC};
+    std::size_t max_inflight_messages{256};    // 异步模式下在途消息上限
+
+    // 流水线模式下发送、确认阶段的线程数和阶段间队列容量，修改后重启生效
+    std::size_t pipeline_send_threads{4};
+    std::size_t pipeline_ack_threads{2};
+    std::size_t pipeline_queue_capacity{1024};
+
+    // 顺序模式下的通道数，不同消息组的消息在各通道间并行发送
+    std::size_t ordered_lanes{16};
+    // 顺序模式下发送失败的消息在通道头部重试的次数和退避，次数用完后
+    // 按发送失败处理（重试、死信），通道继续发送后续消息
+    std::size_t ordered_send_attempts{3};
+    std::size_t ordered_retry_backoff_ms{100};
+    std::size_t ordered_max_retry_backoff_ms{2000};
+
+    DeadlinePacer::Options pacing;    // 截止时间驱动的调速配置
+
+    // 拉取批量和不可见时长的自适应配置，开启后取代固定的
+    // buffer_consumer_batch_size 和 buffer_consumer_invisible_duration
+    BatchTuner::Options adaptive_batch;
+
+    // 发送失败时的本地落盘队列，存储路径修改后需重启生效
+    SpillQueue::Options spill;
+    // 目标主题发送的熔断配置
+    CircuitBreaker::Options circuit_breaker;
+
+    // 停止时继续发送已拉取消息的期限，超过期限未发送的消息被释放
+    std::size_t drain_timeout_ms{5000};
+    // 释放时设置的不可见时长，0 表示立即可被其他实例拉取
+    std::size_t drain_release_invisible_ms{0};
+
+    // 发送失败的消息通过 changeInvisibleDuration 按投递次数指数退避后重新投递
+    struct RetryOptions {
+        bool enable{false};
+        std::size_t initial_backoff_ms{1000};    // 首次投递失败后的退避
+        std::size_t max_backoff_ms{60000};
+        double multiplier{2.0};
+        // 投递次数超过该值的消息转入死信主题，0 表示不限
+        std::size_t max_attempts{16};
+        std::string dead_letter_topic;    // 为空时不转入死信主题
+    };
+    RetryOptions retry;
+    // 首次启用时打开，热加载时沿用，关闭落盘后仍会重放已落盘的消息
+    std::shared_ptr<SpillQueue> spill_queue;
+
+    // 转发延迟分布的日志输出间隔，0 表示不输出
+    std::size_t latency_summary_interval_seconds{60};
+
+    ScheduleMode schedule_mode{ScheduleMode::WINDOW};
+    // broker_delay 模式下投递时间最多提前当前时间多少秒
+    std::size_t broker_delay_max_ahead_seconds{86400};
+
     std::string buffer_consumer_group;
     std::string buffer_consumer_access_point;
     std::string buffer_consumer_topic;
@@ -31,21 +114,33 @@ struct RocketMQDelaySchedulerConfig {
 
     std::string target_producer_access_point;
     std::string target_producer_topic;
+    // 转发时保留原消息的消息组，目标主题需为顺序主题
+    bool preserve_message_group{true};
 
     std::shared_ptr<rocketmq::SimpleConsumer> buffer_mq_consumer;
     std::shared_ptr<rocketmq::Producer> target_mq_producer;
+    // 顺序模式下发送带消息组的消息
+    std::shared_ptr<rocketmq::FifoProducer> target_fifo_producer;
 
     struct TimeWindow {
         std::string id;    // 时间窗口唯一标识
         short start;       // "05:30" -> 530
         short end;         // "09:30" -> 930
         std::shared_ptr<bmq::IRateLimiter> rate_limiter;
+        // 限流器类型和最终配置，热加载时据此判断能否沿用 rate_limiter
+        std::string rate_limiter_type;
+        std::string rate_limiter_config;
+        double rate{0.0};    // 限流器配置中的 rate，用于规划投递时间
         bool enable;
     };
 
     std::vector<TimeWindow> time_windows;
+
+    // 由启用的窗口编译而成的切换表，窗口下标对应 time_windows
+    WindowSchedule schedule;
 };
 
+// 异步回调只持有调度器的回调状态（CallbackState），不持有调度器本身
 class RocketMQDelayScheduler : public bmq::IScheduler {
 public:
     RocketMQDelayScheduler();
@@ -63,24 +158,293 @@ public:
             std::make_shared<RocketMQDelayScheduler>());
     }
 
+    void set_executor(std::shared_ptr<WorkStealingExecutor> executor) override {
+        _executor = std::move(executor);
+    }
+
     // 重新加载配置（线程安全）
     void reload_config();
 
 private:
+    // 并发型限流器的一个在途名额，最后一个引用释放时归还
+    // 持有限流器的强引用：异步发送完成时配置快照可能已被替换
+    class PermitLease {
+    public:
+        explicit PermitLease(std::shared_ptr<IRateLimiter> limiter)
+            : _limiter(std::move(limiter)) {}
+
+        ~PermitLease() { _limiter->release(1); }
+
+        PermitLease(const PermitLease&) = delete;
+        PermitLease& operator=(const PermitLease&) = delete;
+
+    private:
+        std::shared_ptr<IRateLimiter> _limiter;
+    };
+
+    // 单条消息的转发上下文
+    struct ForwardContext {
+        // 非零时以定时消息发送
+        std::chrono::system_clock::time_point deliver_at;
+        int64_t received_us{0};    // 所在批次拉取完成的时刻
+        WindowLatency* latency{nullptr};    // 所在窗口的延迟统计
+        // 所在窗口的限流器，不持有引用：只在 permit 非空（由其保活）时
+        // 访问，令牌型限流器没有 permit，也不需要发送结果的反馈
+        IRateLimiter* limiter{nullptr};
+        // 并发型限流器授予该消息的名额，随上下文的最后一份拷贝归还
+        std::shared_ptr<PermitLease> permit;
+    };
+
+    // 流水线中在阶段间传递的消息
+    struct PipelineItem {
+        std::shared_ptr<rocketmq::SimpleConsumer> consumer;
+        std::shared_ptr<rocketmq::Producer> producer;
+        rocketmq::MessageConstSharedPtr message;    // 缓冲队列中的原消息
+        rocketmq::MessageConstPtr target;           // 待发送的目标消息
+        std::shared_ptr<SpillQueue> spill_queue;    // 未启用落盘时为空
+        std::chrono::milliseconds retry_backoff;    // 发送失败后的退避
+        ForwardContext ctx;
+    };
+
+    // 限流请求的结果
+    struct PermitResult {
+        std::size_t granted;
+        std::chrono::milliseconds retry_after;
+    };
+
+    // 顺序模式下被隔离的消息组
+    struct GroupFence {
+        std::string message_id;    // 重试次数用完的消息
+        int64_t expire_ms;         // 隔离的到期时间（steady clock）
+    };
+
+    // 异步回调访问的状态，回调只持有该状态而不持有调度器：stop() 等待超时后
+    // 迟到的回调仍可安全访问，调度器及其客户端总在持有者的线程中析构，
+    // 不会在客户端的回调线程中析构
+    struct CallbackState : public std::enable_shared_from_this<CallbackState> {
+        CircuitBreaker circuit_breaker;    // 目标主题不可用时暂停拉取和发送
+        SchedulerMetrics metrics;
+
+        std::mutex inflight_mtx;
+        std::condition_variable inflight_cv;
+        // 已发送但未完成确认的消息数，以及未完成的异步
+        // changeInvisibleDuration 和令牌请求
+        std::size_t inflight_count{0};
+
+        std::mutex fence_mtx;
+        std::unordered_map<std::string, GroupFence> group_fences;
+
+        void release_inflight_slot();
+
+        // 不受上限约束地计入一个在途请求，用于回调中引用本状态的异步请求
+        void track_inflight();
+
+        void record_permits(std::size_t requested, std::size_t granted,
+                            int64_t start_us);
+
+        // 记录一次发送到目标主题的耗时和结果
+        void record_send_result(const ForwardContext& ctx, bool success,
+                                int64_t latency_us);
+
+        // 记录一条发送成功的消息
+        void record_forwarded(const ForwardContext& ctx,
+                              const rocketmq::Message& message);
+
+        // 顺序模式下通道内重试次数用完时隔离消息组，ttl_ms 后自动解除
+        void fence_group(const rocketmq::Message& message, int64_t ttl_ms);
+
+        // 发送失败的消息在 backoff 后重新投递，backoff 为 0 时等待不可见
+        // 时间结束
+        void retry_later(
+            const std::shared_ptr<rocketmq::SimpleConsumer>& consumer,
+            const rocketmq::MessageConstSharedPtr& message,
+            std::chrono::milliseconds backoff);
+
+        // 释放未发送的消息：缩短不可见时间，使其他实例尽快拉取
+        void release_message(
+            const std::shared_ptr<rocketmq::SimpleConsumer>& consumer,
+            const rocketmq::MessageConstSharedPtr& message,
+            std::chrono::milliseconds invisible_duration);
+    };
+
+    // 单个拉取转发任务在多次执行之间保留的状态
+    struct WorkerState {
+        // 持有的配置快照，仅在版本号变化时重新获取
+        std::shared_ptr<const RocketMQDelaySchedulerConfig> cfg;
+        uint64_t cfg_version{0};
+
+        // 预取的下一批次令牌，与本批次的转发重叠执行。配置版本和限流器
+        // 都相同时才有效，否则归还给 prefetch_limiter；只有异步的令牌型
+        // 限流器预取
+        std::shared_ptr<IRateLimiter> prefetch_limiter;
+        uint64_t prefetch_cfg_version{0};
+        std::future<PermitResult> prefetch_permits;
+
+        // 窗口相关的指标对象只在窗口变化时重新获取
+        const RocketMQDelaySchedulerConfig::TimeWindow* last_window{nullptr};
+        WindowLatency* window_latency{nullptr};
+        bool window_stale{true};
+
+        std::vector<rocketmq::MessageConstSharedPtr> messages;
+    };
+
+    // 未使用共享执行器时的工作线程
     void worker_thread_func();
 
-    void enable_hot_reload();
+    // 执行一次拉取转发，返回下一次执行前需要等待的时间
+    std::chrono::milliseconds run_once(WorkerState* state);
 
-    static bool modify(RocketMQDelaySchedulerConfig& bg_cfg,
-                       const RocketMQDelaySchedulerConfig& new_cfg) {
-        bg_cfg = new_cfg;
-        return true;
-    }
+    // 在 delay 后把拉取转发任务提交到共享执行器，任务执行完后再次提交自身
+    // seq 为任务上次执行前的唤醒序号，用于检测等待期间错过的唤醒
+    void schedule_worker_task(const std::shared_ptr<WorkerState>& state,
+                              std::chrono::milliseconds delay, uint64_t seq);
+
+    // 时钟线程：在每次窗口切换时发布当前活动窗口，其余时间休眠
+    void clock_thread_func();
+
+    // 唤醒时钟线程重新计算活动窗口（配置更新、停止时调用）
+    void notify_clock();
+
+    // 工作线程等待 timeout，调度器停止、配置更新或窗口切换时提前返回
+    void wait_for(std::chrono::milliseconds timeout);
+
+    // 唤醒所有在 wait_for 中等待的工作线程和执行器中等待的任务
+    void wake_workers();
+
+    uint64_t wake_seq();
+
+    // 读取时钟线程发布的活动窗口，发布的版本与 cfg 不一致时直接查切换表
+    const RocketMQDelaySchedulerConfig::TimeWindow* find_active_window(
+        const RocketMQDelaySchedulerConfig& cfg, uint64_t cfg_version) const;
+
+    // 当前本地时间在当天的秒数
+    int32_t seconds_of_day() const;
+
+    // 发起异步令牌请求，限流检查可与 receive()/send() 重叠执行
+    std::future<PermitResult> request_permits(IRateLimiter* limiter,
+                                              std::size_t permits);
+
+    // 作废预取的令牌并归还给发起预取的限流器，结果未返回时等待
+    void discard_prefetch(WorkerState* state);
+
+    // 同步获取令牌，用于本地限流器，不分配等待结果的对象
+    PermitResult acquire_permits(IRateLimiter* limiter, std::size_t permits);
+
+    // 从缓冲队列拉取至多 batch_size 条消息并记录指标，失败时返回 false
+    bool receive_messages(
+        const RocketMQDelaySchedulerConfig& cfg, std::size_t batch_size,
+        std::vector<rocketmq::MessageConstSharedPtr>* messages);
+
+    // broker_delay 模式：消费一批消息并按投递计划以定时消息转发
+    // 返回下一次执行前需要等待的时间
+    std::chrono::milliseconds forward_with_delivery_plan(
+        const RocketMQDelaySchedulerConfig& cfg);
+
+    // 按转发模式转发单条消息
+    void forward_message(const RocketMQDelaySchedulerConfig& cfg,
+                         const rocketmq::MessageConstSharedPtr& message,
+                         const ForwardContext& ctx);
+
+    // 同步转发单条消息：发送成功后确认缓冲队列中的消息
+    void forward_message_sync(const RocketMQDelaySchedulerConfig& cfg,
+                              const rocketmq::MessageConstSharedPtr& message,
+                              const ForwardContext& ctx);
+
+    // 异步转发单条消息：send 回调中链式调用 asyncAck
+    void forward_message_async(const RocketMQDelaySchedulerConfig& cfg,
+                               const rocketmq::MessageConstSharedPtr& message,
+                               const ForwardContext& ctx);
+
+    // 顺序转发单条消息：带消息组的消息经 FifoProducer 的通道依次发送
+    void forward_message_ordered(
+        const RocketMQDelaySchedulerConfig& cfg,
+        const rocketmq::MessageConstSharedPtr& message,
+        const ForwardContext& ctx);
+
+    // 消息组被隔离且本条不是发送失败的那条消息时返回 false；失败的消息
+    // 重新投递到本实例或隔离到期时解除隔离，并恢复 FifoProducer 的通道
+    bool pass_group_fence(const RocketMQDelaySchedulerConfig& cfg,
+                          const rocketmq::Message& message);
+
+    // 异步发送的回调：发送成功后异步确认，完成后释放在途名额
+    rocketmq::SendCallback make_send_callback(
+        const RocketMQDelaySchedulerConfig& cfg,
+        const rocketmq::MessageConstSharedPtr& message,
+        const ForwardContext& ctx);
+
+    // 熔断期间不发送已拉取的消息：启用落盘时落盘后确认，否则等待重新投递
+    void divert_message(const RocketMQDelaySchedulerConfig& cfg,
+                        const rocketmq::MessageConstSharedPtr& message,
+                        const ForwardContext& ctx);
+
+    // 把超过最大投递次数的消息发送到死信主题，成功后确认
+    // 死信主题与目标主题共用生产者，发送结果同样计入熔断统计
+    void forward_dead_letter(const RocketMQDelaySchedulerConfig& cfg,
+                             const rocketmq::MessageConstSharedPtr& message,
+                             const ForwardContext& ctx);
+
+    // 从落盘队列重放至多 max 条消息，返回重放成功（含丢弃的损坏记录）的数量
+    std::size_t replay_spilled(const RocketMQDelaySchedulerConfig& cfg,
+                               std::size_t max);
+
+    // 流水线模式：把消息放入发送队列，队列满时阻塞拉取线程
+    void forward_message_pipeline(
+        const RocketMQDelaySchedulerConfig& cfg,
+        const rocketmq::MessageConstSharedPtr& message,
+        const ForwardContext& ctx);
+
+    // 流水线发送阶段：发送成功的消息进入确认队列
+    void pipeline_send_thread_func();
+
+    // 发送一条流水线消息，发送成功或落盘成功时返回 true，需要确认
+    bool send_pipeline_item(PipelineItem* item);
+
+    // 流水线确认阶段：发送阶段全部退出后清空确认队列再退出
+    void pipeline_ack_thread_func();
+
+    // 获取在途窗口名额，停止后超过排空期限时返回 false
+    bool acquire_inflight_slot(std::size_t max_inflight);
+
+    // 等待所有在途的异步转发完成，最多等到排空期限之后 kInflightGraceMs
+    void wait_inflight_drained();
+
+    // 调度器已停止且超过排空期限，剩余消息不再发送
+    bool drain_expired() const;
+
+    // 排空期限，调度器运行时为 time_point::max()
+    std::chrono::steady_clock::time_point drain_deadline() const;
+
+    void enable_hot_reload();
 
 private:
     std::atomic<bool> _running;
     std::vector<std::thread> _worker_threads;
-    butil::DoublyBufferedData<RocketMQDelaySchedulerConfig> _cfg;
+    std::shared_ptr<WorkStealingExecutor> _executor;    // 共享执行器，可为空
+    std::shared_ptr<WorkStealingExecutor::Group> _executor_group;
+    std::mutex _wake_mtx;
+    std::condition_variable _wake_cv;
+    uint64_t _wake_seq;    // 每次唤醒递增，等待方据此判断是否被唤醒
+    std::thread _clock_thread;
+    std::mutex _clock_mtx;
+    std::condition_variable _clock_cv;
+    std::atomic<uint64_t> _active_window;       // 见 pack_active_window
+    std::atomic<int64_t> _local_midnight_ms;    // 当天本地零点的时间戳
+    std::atomic<int64_t> _drain_deadline_ms;    // 排空期限（steady clock）
+    std::vector<std::thread> _send_threads;
+    std::vector<std::thread> _ack_threads;
+    std::atomic<std::size_t> _active_send_threads;
+    std::atomic<bool> _workers_stopped;    // 拉取阶段已全部退出
+    std::unique_ptr<BlockingMPMCQueue<PipelineItem>> _send_queue;
+    std::unique_ptr<BlockingMPMCQueue<PipelineItem>> _ack_queue;
+    // 不可变的配置快照，热加载时整体替换
+    VersionedSnapshot<RocketMQDelaySchedulerConfig> _cfg;
+    DeadlinePacer _pacer;    // 按窗口剩余时间动态调整限流速率
+    // 在途计数、熔断器和指标等回调访问的状态，以下两个引用是其成员的别名
+    std::shared_ptr<CallbackState> _callback_state;
+    CircuitBreaker& _circuit_breaker;
+    SchedulerMetrics& _metrics;
+    BatchTuner _batch_tuner;    // 按转发耗时调整拉取批量和不可见时长
+    DeliveryPlanner _delivery_planner;    // broker_delay 模式的投递时间规划
     std::string _name;    // 调度器名称，用于生成唯一的限流器 key
     std::string _config_file;    // 配置文件路径，用于热加载
     std::unique_ptr<RocketMQDelaySchedulerHotLoadTask>
@@ -1,5 +1,6 @@
 #include "scheduler_manager.h"
 
+#include <map>
 #include <set>
 
 #include "global.h"
@@ -11,6 +12,37 @@ namespace bmq {
 SchedulerManager::~SchedulerManager() { stop_all(); }
 
 bool SchedulerManager::load_from_config(const std::string& config_file) {
+    std::vector<SchedulerSpec> specs;
+    if (!parse_config(config_file, &specs, &_executor_threads,
+                      &_max_blocking_threads)) {
+        return false;
+    }
+
+    _config_file = config_file;
+    _executor = std::make_shared<WorkStealingExecutor>();
+
+    std::vector<SchedulerInstance> schedulers;
+    for (const auto& spec : specs) {
+        SchedulerInstance instance;
+        if (!create_scheduler(spec, &instance)) {
+            return false;
+        }
+        schedulers.push_back(std::move(instance));
+    }
+
+    if (schedulers.empty()) {
+        SPDLOG_WARN("No schedulers loaded from config file: {}", config_file);
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _schedulers = std::move(schedulers);
+    return true;
+}
+
+bool SchedulerManager::parse_config(const std::string& config_file,
+                                    std::vector<SchedulerSpec>* specs,
+                                    std::size_t* executor_threads,
+                                    std::size_t* max_blocking_threads) {
     try {
         YAML::Node config_node = YAML::LoadFile(config_file);
 
@@ -20,27 +52,39 @@ bool SchedulerManager::load_from_config(const std::string& config_file) {
             return false;
         }
 
+        // 共享执行器配置（可选）
+        YAML::Node executor_node = config_node["executor"];
+        *executor_threads = 0;
+        if (executor_node["threads"].IsDefined()) {
+            *executor_threads = executor_node["threads"].as<std::size_t>();
+        }
+        *max_blocking_threads = 64;
+        if (executor_node["max_blocking_threads"].IsDefined()) {
+            *max_blocking_threads =
+                executor_node["max_blocking_threads"].as<std::size_t>();
+        }
+
         YAML::Node schedulers_node = config_node["schedulers"];
 
         // 用于检查调度器名称重复
         std::set<std::string> scheduler_names;
 
         for (const auto& scheduler_node : schedulers_node) {
-            SchedulerInstance instance;
+            SchedulerSpec spec;
 
             // 读取调度器名称（必需）
             if (!scheduler_node["name"].IsDefined()) {
                 SPDLOG_ERROR("Scheduler 'name' is required");
                 return false;
             }
-            instance.name = scheduler_node["name"].as<std::string>();
+            spec.name = scheduler_node["name"].as<std::string>();
 
             // 检查调度器名称是否重复
-            if (scheduler_names.find(instance.name) != scheduler_names.end()) {
-                SPDLOG_ERROR("Duplicate scheduler name '{}'", instance.name);
+            if (scheduler_names.find(spec.name) != scheduler_names.end()) {
+                SPDLOG_ERROR("Duplicate scheduler name '{}'", spec.name);
                 return false;
             }
-            scheduler_names.insert(instance.name);
+            scheduler_names.insert(spec.name);
 
             // 读取是否启用（可选，默认为 true）
             bool enabled = true;
@@ -50,57 +94,25 @@ bool SchedulerManager::load_from_config(const std::string& config_file) {
 
             if (!enabled) {
                 SPDLOG_INFO("Scheduler '{}' is disabled, skipping",
-                            instance.name);
+                            spec.name);
                 continue;
             }
 
             // 读取配置文件路径（必需）
             if (!scheduler_node["config_file"].IsDefined()) {
                 SPDLOG_ERROR("Scheduler 'config_file' is required for '{}'",
-                             instance.name);
+                             spec.name);
                 return false;
             }
-            instance.config_file =
-                scheduler_node["config_file"].as<std::string>();
+            spec.config_file = scheduler_node["config_file"].as<std::string>();
 
             // 读取调度器类型（可选，默认为 rocketmq_delay_scheduler）
-            std::string scheduler_type = "rocketmq_delay_scheduler";
+            spec.type = "rocketmq_delay_scheduler";
             if (scheduler_node["type"].IsDefined()) {
-                scheduler_type = scheduler_node["type"].as<std::string>();
-            }
-
-            // 从扩展系统获取调度器实现
-            const IScheduler* scheduler_ext =
-                SchedulerExtension()->Find(scheduler_type.c_str());
-            if (!scheduler_ext) {
-                SPDLOG_ERROR("Scheduler extension '{}' not found for '{}'",
-                             scheduler_type, instance.name);
-                return false;
-            }
-
-            // 克隆调度器实例
-            instance.scheduler = scheduler_ext->clone();
-            if (!instance.scheduler) {
-                SPDLOG_ERROR("Failed to clone scheduler '{}'", instance.name);
-                return false;
-            }
-
-            // 初始化调度器（传入名称和配置文件）
-            if (!instance.scheduler->init(instance.name,
-                                          instance.config_file)) {
-                SPDLOG_ERROR(
-                    "Failed to initialize scheduler '{}' from config: {}",
-                    instance.name, instance.config_file);
-                return false;
+                spec.type = scheduler_node["type"].as<std::string>();
             }
 
-            _schedulers.push_back(std::move(instance));
-            SPDLOG_INFO("Scheduler '{}' loaded successfully", instance.name);
-        }
-
-        if (_schedulers.empty()) {
-            SPDLOG_WARN("No schedulers loaded from config file: {}",
-                        config_file);
+            specs->push_back(std::move(spec));
         }
 
         return true;
@@ -112,9 +124,55 @@ bool SchedulerManager::load_from_config(const std::string& config_file) {
     }
 }
 
+bool SchedulerManager::create_scheduler(const SchedulerSpec& spec,
+                                        SchedulerInstance* instance) {
+    // 从扩展系统获取调度器实现
+    const IScheduler* scheduler_ext =
+        SchedulerExtension()->Find(spec.type.c_str());
+    if (!scheduler_ext) {
+        SPDLOG_ERROR("Scheduler extension '{}' not found for '{}'", spec.type,
+                     spec.name);
+        return false;
+    }
+
+    // 克隆调度器实例
+    instance->scheduler = scheduler_ext->clone();
+    if (!instance->scheduler) {
+        SPDLOG_ERROR("Failed to clone scheduler '{}'", spec.name);
+        return false;
+    }
+    instance->scheduler->set_executor(_executor);
+
+    // 初始化调度器（传入名称和配置文件）
+    if (!instance->scheduler->init(spec.name, spec.config_file)) {
+        SPDLOG_ERROR("Failed to initialize scheduler '{}' from config: {}",
+                     spec.name, spec.config_file);
+        instance->scheduler.reset();
+        return false;
+    }
+
+    instance->name = spec.name;
+    instance->type = spec.type;
+    instance->config_file = spec.config_file;
+    SPDLOG_INFO("Scheduler '{}' loaded successfully", spec.name);
+    return true;
+}
+
+size_t SchedulerManager::get_scheduler_count() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _schedulers.size();
+}
+
 void SchedulerManager::start_all() {
+    std::lock_guard<std::mutex> lock(_mtx);
     SPDLOG_INFO("Starting {} scheduler(s)...", _schedulers.size());
 
+    if (_executor &&
+        !_executor->start(_executor_threads, _max_blocking_threads)) {
+        SPDLOG_ERROR("Failed to start shared executor");
+        return;
+    }
+
     for (const auto& instance : _schedulers) {
         try {
             instance.scheduler->start();
@@ -125,10 +183,33 @@ void SchedulerManager::start_all() {
         }
     }
 
+    if (!_reload_thread.joinable()) {
+        _reload_stopping = false;
+        _reload_thread =
+            std::thread(&SchedulerManager::reload_thread_func, this);
+        enable_hot_reload();
+    }
+
     SPDLOG_INFO("All schedulers started");
 }
 
 void SchedulerManager::stop_all() {
+    // 先停止热加载，之后调度器列表不会再被修改
+    if (_hot_load_task) {
+        HotLoader::instance().unregister_task(_hot_load_task.get());
+        _hot_load_task.reset();
+    }
+
+    if (_reload_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_reload_mtx);
+            _reload_stopping = true;
+        }
+        _reload_cv.notify_all();
+        _reload_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
     SPDLOG_INFO("Stopping {} scheduler(s)...", _schedulers.size());
 
     for (const auto& instance : _schedulers) {
@@ -141,7 +222,124 @@ void SchedulerManager::stop_all() {
         }
     }
 
+    // 调度器全部停止后再停止执行器
+    if (_executor) {
+        _executor->stop();
+    }
+
     SPDLOG_INFO("All schedulers stopped");
 }
 
+void SchedulerManager::request_reload() {
+    {
+        std::lock_guard<std::mutex> lock(_reload_mtx);
+        _reload_pending = true;
+    }
+    _reload_cv.notify_all();
+}
+
+void SchedulerManager::reload_thread_func() {
+    std::unique_lock<std::mutex> lock(_reload_mtx);
+    while (true) {
+        _reload_cv.wait(lock,
+                        [this] { return _reload_stopping || _reload_pending; });
+        if (_reload_stopping) {
+            break;
+        }
+
+        // 编辑器保存时可能触发多次事件，合并为一次重载
+        _reload_pending = false;
+        lock.unlock();
+        apply_config();
+        lock.lock();
+    }
+}
+
+void SchedulerManager::apply_config() {
+    SPDLOG_INFO("Reloading schedulers from: {}", _config_file);
+
+    std::vector<SchedulerSpec> specs;
+    std::size_t executor_threads = 0;
+    std::size_t max_blocking_threads = 0;
+    if (!parse_config(_config_file, &specs, &executor_threads,
+                      &max_blocking_threads)) {
+        SPDLOG_ERROR("Failed to reload {}, keeping current schedulers",
+                     _config_file);
+        return;
+    }
+
+    if (executor_threads != _executor_threads ||
+        max_blocking_threads != _max_blocking_threads) {
+        SPDLOG_WARN("executor settings changed, restart to take effect");
+    }
+
+    std::map<std::string, const SchedulerSpec*> wanted;
+    for (const auto& spec : specs) {
+        wanted[spec.name] = &spec;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    // 先停止删除和变化的调度器：同名调度器的指标名称和落盘目录被旧实例占用，
+    // 旧实例释放后才能初始化新实例
+    std::vector<SchedulerInstance> kept;
+    std::set<std::string> running;
+    for (auto& instance : _schedulers) {
+        auto it = wanted.find(instance.name);
+        if (it != wanted.end() && it->second->type == instance.type &&
+            it->second->config_file == instance.config_file) {
+            running.insert(instance.name);
+            kept.push_back(std::move(instance));
+            continue;
+        }
+
+        try {
+            instance.scheduler->stop();
+            SPDLOG_INFO("Scheduler '{}' stopped", instance.name);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("Failed to stop scheduler '{}': {}", instance.name,
+                         e.what());
+        }
+    }
+    _schedulers = std::move(kept);
+
+    // 再按主配置文件中的顺序启动新增和变化的调度器
+    for (const auto& spec : specs) {
+        if (running.count(spec.name)) {
+            continue;
+        }
+
+        SchedulerInstance instance;
+        if (!create_scheduler(spec, &instance)) {
+            continue;
+        }
+
+        try {
+            instance.scheduler->start();
+            SPDLOG_INFO("Scheduler '{}' started", instance.name);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("Failed to start scheduler '{}': {}", instance.name,
+                         e.what());
+            continue;
+        }
+        _schedulers.push_back(std::move(instance));
+    }
+
+    SPDLOG_INFO("Schedulers reloaded, {} running", _schedulers.size());
+}
+
+void SchedulerManager::enable_hot_reload() {
+    _hot_load_task =
+        std::make_unique<SchedulerManagerHotLoadTask>(this, _config_file);
+
+    if (HotLoader::instance().register_task(_hot_load_task.get(),
+                                            HotLoader::DOESNT_OWN_TASK) != 0) {
+        SPDLOG_ERROR("Failed to register hot load task for {}", _config_file);
+        _hot_load_task.reset();
+        return;
+    }
+
+    SPDLOG_INFO("Hot reload enabled for config file: {}", _config_file);
+}
+
 }    // namespace bmq
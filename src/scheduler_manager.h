@@ -1,13 +1,21 @@
 #pragma once
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "hot_loader.h"
 #include "ischeduler.h"
+#include "work_stealing_executor.h"
+#include "spdlog/spdlog.h"
 
 namespace bmq {
 
+class SchedulerManagerHotLoadTask;
+
 class SchedulerManager {
 public:
     SchedulerManager() = default;
@@ -16,23 +24,86 @@ public:
     // 从主配置文件加载所有调度器
     bool load_from_config(const std::string& config_file);
 
-    // 启动所有调度器
+    // 启动所有调度器，并开始监听主配置文件的变化
     void start_all();
 
     // 停止所有调度器
     void stop_all();
 
     // 获取调度器数量
-    size_t get_scheduler_count() const { return _schedulers.size(); }
+    size_t get_scheduler_count() const;
+
+    // 主配置文件变化时由热加载任务调用，实际的变更在重载线程中进行
+    void request_reload();
 
 private:
+    // 主配置文件中一个启用的调度器
+    struct SchedulerSpec {
+        std::string name;
+        std::string type;
+        std::string config_file;
+    };
+
     struct SchedulerInstance {
         std::string name;
+        std::string type;
         std::shared_ptr<bmq::IScheduler> scheduler;
         std::string config_file;
     };
 
+    // 解析主配置文件，得到启用的调度器列表和执行器线程数
+    static bool parse_config(const std::string& config_file,
+                             std::vector<SchedulerSpec>* specs,
+                             std::size_t* executor_threads,
+                             std::size_t* max_blocking_threads);
+
+    // 创建并初始化调度器
+    bool create_scheduler(const SchedulerSpec& spec,
+                          SchedulerInstance* instance);
+
+    // 重新读取主配置文件：启动新增的调度器，停止删除的调度器，
+    // 重启 type 或 config_file 变化的调度器，其余调度器不受影响
+    void apply_config();
+
+    void reload_thread_func();
+
+    void enable_hot_reload();
+
+private:
+    std::string _config_file;
+
+    mutable std::mutex _mtx;    // 保护 _schedulers
     std::vector<SchedulerInstance> _schedulers;
+
+    // 所有调度器共享的执行器
+    std::shared_ptr<WorkStealingExecutor> _executor;
+    std::size_t _executor_threads{0};    // 0 表示 CPU 核数
+    std::size_t _max_blocking_threads{64};    // 阻塞区间内顶替执行的线程数上限
+
+    // 热加载任务在 HotLoader 持锁期间回调，启停调度器需要再次获取该锁，
+    // 因此回调只登记请求，由重载线程完成变更
+    std::unique_ptr<SchedulerManagerHotLoadTask> _hot_load_task;
+    std::thread _reload_thread;
+    std::mutex _reload_mtx;
+    std::condition_variable _reload_cv;
+    bool _reload_pending{false};
+    bool _reload_stopping{false};
+};
+
+// 主配置文件的热加载任务
+class SchedulerManagerHotLoadTask : public HotLoadTask {
+public:
+    SchedulerManagerHotLoadTask(SchedulerManager* manager,
+                                const std::string& file)
+        : HotLoadTask(file), _manager(manager) {}
+
+    void on_reload() override {
+        SPDLOG_INFO("Hot reload triggered for config file: {}", watch_file());
+        _manager->request_reload();
+    }
+
+private:
+    SchedulerManager* _manager;
 };
 
 }    // namespace bmq
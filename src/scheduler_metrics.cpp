@@ -0,0 +1,118 @@
+#include "scheduler_metrics.h"
+
+#include <sstream>
+
+#include "spdlog/spdlog.h"
+
+namespace bmq {
+
+void ForwardLatencyStats::expose(const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_status) {
+        _status = std::make_unique<bvar::PassiveStatus<std::string>>(
+            &ForwardLatencyStats::describe_status, this);
+    }
+    _status->expose(prefix + "_forward_latency");
+}
+
+WindowLatency* ForwardLatencyStats::get(const std::string& window_id) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto& latency = _windows[window_id];
+    if (!latency) {
+        latency = std::make_unique<WindowLatency>();
+    }
+    return latency.get();
+}
+
+void ForwardLatencyStats::maybe_log_summary(std::chrono::seconds interval) {
+    if (interval.count() <= 0) {
+        return;
+    }
+
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+    int64_t last_ms = _last_summary_ms.load(std::memory_order_relaxed);
+    if (now_ms - last_ms <
+        std::chrono::duration_cast<std::chrono::milliseconds>(interval)
+            .count()) {
+        return;
+    }
+
+    // 只由一个线程输出
+    if (!_last_summary_ms.compare_exchange_strong(last_ms, now_ms)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    for (const auto& entry : _windows) {
+        LastSnapshots current{entry.second->born_to_forward_ms.snapshot(),
+                              entry.second->receive_to_send_us.snapshot()};
+        LastSnapshots& last = _last_snapshots[entry.first];
+
+        auto born_to_forward =
+            current.born_to_forward_ms.since(last.born_to_forward_ms);
+        auto receive_to_send =
+            current.receive_to_send_us.since(last.receive_to_send_us);
+        last = std::move(current);
+
+        if (born_to_forward.total == 0 && receive_to_send.total == 0) {
+            continue;
+        }
+
+        SPDLOG_INFO(
+            "Forward latency of window '{}': born_to_forward_ms {}, "
+            "receive_to_send_us {}",
+            entry.first, format(born_to_forward), format(receive_to_send));
+    }
+}
+
+std::string ForwardLatencyStats::describe() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::ostringstream os;
+    for (const auto& entry : _windows) {
+        os << "window " << entry.first << ": born_to_forward_ms "
+           << format(entry.second->born_to_forward_ms.snapshot())
+           << ", receive_to_send_us "
+           << format(entry.second->receive_to_send_us.snapshot()) << "\n";
+    }
+    return os.str();
+}
+
+std::string ForwardLatencyStats::describe_status(void* arg) {
+    return static_cast<ForwardLatencyStats*>(arg)->describe();
+}
+
+std::string ForwardLatencyStats::format(
+    const LatencyHistogram::Snapshot& snap) {
+    std::ostringstream os;
+    os << "{count=" << snap.total << " mean=" << snap.mean()
+       << " p50=" << snap.percentile(0.5) << " p90=" << snap.percentile(0.9)
+       << " p99=" << snap.percentile(0.99)
+       << " p999=" << snap.percentile(0.999) << " max=" << snap.max() << "}";
+    return os.str();
+}
+
+void SchedulerMetrics::expose(const std::string& prefix) {
+    received.expose(prefix + "_received");
+    forwarded.expose(prefix + "_forwarded");
+    send_failures.expose(prefix + "_send_failures");
+    ack_failures.expose(prefix + "_ack_failures");
+    retries.expose(prefix + "_retries");
+    dead_lettered.expose(prefix + "_dead_lettered");
+    released.expose(prefix + "_released");
+    limiter_granted.expose(prefix + "_limiter_granted");
+    limiter_denials.expose(prefix + "_limiter_denials");
+    forwarded_per_second.expose(prefix + "_effective_rate");
+
+    receive_latency.expose(prefix, "receive");
+    send_latency.expose(prefix, "send");
+    ack_latency.expose(prefix, "ack");
+    limiter_latency.expose(prefix, "limiter");
+
+    active_window.expose(prefix + "_active_window");
+
+    forward_latency.expose(prefix);
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "bvar/bvar.h"
+#include "latency_histogram.h"
+
+namespace bmq {
+
+// 单个时间窗口的转发延迟分布
+struct WindowLatency {
+    LatencyHistogram born_to_forward_ms;    // 消息生产到转发成功（毫秒）
+    LatencyHistogram receive_to_send_us;    // 拉取完成到发送成功（微秒）
+};
+
+// 按时间窗口统计的转发延迟
+//
+// 累计分布通过 bvar 暴露为文本，另外定期把上一个统计周期内的分布输出到日志
+class ForwardLatencyStats {
+public:
+    ForwardLatencyStats() : _last_summary_ms(0) {}
+
+    // 以 <prefix>_forward_latency 暴露各窗口的累计分布
+    void expose(const std::string& prefix);
+
+    // 获取窗口的延迟统计，不存在时创建
+    // 窗口统计只增不删，返回的指针在本对象的生命周期内有效
+    WindowLatency* get(const std::string& window_id);
+
+    // 距上次输出超过 interval 时输出各窗口在该周期内的延迟分布
+    void maybe_log_summary(std::chrono::seconds interval);
+
+    // 各窗口累计分布的文本描述
+    std::string describe() const;
+
+private:
+    struct LastSnapshots {
+        LatencyHistogram::Snapshot born_to_forward_ms;
+        LatencyHistogram::Snapshot receive_to_send_us;
+    };
+
+    static std::string describe_status(void* arg);
+
+    static std::string format(const LatencyHistogram::Snapshot& snap);
+
+    mutable std::mutex _mtx;
+    std::map<std::string, std::unique_ptr<WindowLatency>> _windows;
+    std::map<std::string, LastSnapshots> _last_snapshots;
+    std::atomic<int64_t> _last_summary_ms;
+    std::unique_ptr<bvar::PassiveStatus<std::string>> _status;
+};
+
+// 调度器的运行指标，通过 bvar 暴露，可在内置服务的 /vars 页面查看
+//
+// 所有指标以调度器名称为前缀，例如 <name>_received、<name>_send_latency
+struct SchedulerMetrics {
+    SchedulerMetrics() : forwarded_per_second(&forwarded) {}
+
+    // 以 prefix 为前缀暴露全部指标，重复调用时按新前缀重新暴露
+    void expose(const std::string& prefix);
+
+    bvar::Adder<int64_t> received;           // 拉取到的消息数
+    bvar::Adder<int64_t> forwarded;          // 发送成功的消息数
+    bvar::Adder<int64_t> send_failures;      // 发送失败的消息数
+    bvar::Adder<int64_t> ack_failures;       // 确认失败的消息数
+    bvar::Adder<int64_t> retries;            // 退避后重新投递的消息数
+    bvar::Adder<int64_t> dead_lettered;      // 转入死信主题的消息数
+    bvar::Adder<int64_t> released;           // 停止时释放的未发送消息数
+    bvar::Adder<int64_t> limiter_granted;    // 限流器授予的令牌数
+    bvar::Adder<int64_t> limiter_denials;    // 限流器拒绝的令牌数
+    bvar::PerSecond<bvar::Adder<int64_t>> forwarded_per_second;    // 实际速率
+
+    bvar::LatencyRecorder receive_latency;    // 单次 receive() 耗时（微秒）
+    bvar::LatencyRecorder send_latency;       // 单条消息发送耗时（微秒）
+    bvar::LatencyRecorder ack_latency;        // 单条消息确认耗时（微秒）
+    bvar::LatencyRecorder limiter_latency;    // 单次令牌请求耗时（微秒）
+
+    bvar::Status<std::string> active_window;    // 当前生效的窗口 id
+
+    ForwardLatencyStats forward_latency;
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,389 @@
+#include "spill_queue.h"
+
+#include <algorithm>
+
+#include "leveldb/write_batch.h"
+#include "spdlog/spdlog.h"
+
+namespace bmq {
+
+// 记录格式版本，格式变化时递增
+static constexpr uint8_t kFormatVersion = 1;
+
+static void put_fixed32(std::string* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+}
+
+static void put_fixed64(std::string* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out->push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+}
+
+static void put_string(std::string* out, const std::string& value) {
+    put_fixed32(out, static_cast<uint32_t>(value.size()));
+    out->append(value);
+}
+
+// 按顺序解析 put_* 写入的字段，越界时返回 false
+class Reader {
+public:
+    explicit Reader(const leveldb::Slice& input)
+        : _data(input.data()), _remaining(input.size()) {}
+
+    bool get_fixed32(uint32_t* value) {
+        if (_remaining < 4) {
+            return false;
+        }
+        *value = 0;
+        for (int i = 0; i < 4; ++i) {
+            *value |= static_cast<uint32_t>(static_cast<uint8_t>(_data[i]))
+                      << (i * 8);
+        }
+        skip(4);
+        return true;
+    }
+
+    bool get_fixed64(uint64_t* value) {
+        if (_remaining < 8) {
+            return false;
+        }
+        *value = 0;
+        for (int i = 0; i < 8; ++i) {
+            *value |= static_cast<uint64_t>(static_cast<uint8_t>(_data[i]))
+                      << (i * 8);
+        }
+        skip(8);
+        return true;
+    }
+
+    bool get_string(std::string* value) {
+        uint32_t size = 0;
+        if (!get_fixed32(&size) || _remaining < size) {
+            return false;
+        }
+        value->assign(_data, size);
+        skip(size);
+        return true;
+    }
+
+    bool get_byte(uint8_t* value) {
+        if (_remaining < 1) {
+            return false;
+        }
+        *value = static_cast<uint8_t>(_data[0]);
+        skip(1);
+        return true;
+    }
+
+private:
+    void skip(std::size_t n) {
+        _data += n;
+        _remaining -= n;
+    }
+
+    const char* _data;
+    std::size_t _remaining;
+};
+
+SpillQueue::SpillQueue()
+    : _head_seq(0),
+      _next_seq(0),
+      _count(0),
+      _bytes(0),
+      _replaying(false),
+      _replay_after_ms(0),
+      _size_status(&SpillQueue::get_size, this),
+      _bytes_status(&SpillQueue::get_bytes, this) {}
+
+SpillQueue::~SpillQueue() = default;
+
+bool SpillQueue::open(const std::string& path, const Options& options) {
+    leveldb::Options db_options;
+    db_options.create_if_missing = true;
+
+    leveldb::DB* db = nullptr;
+    leveldb::Status status = leveldb::DB::Open(db_options, path, &db);
+    if (!status.ok()) {
+        SPDLOG_ERROR("Failed to open spill queue at {}: {}", path,
+                     status.ToString());
+        return false;
+    }
+    _db.reset(db);
+
+    // 恢复队头、队尾序号以及落盘的消息数和字节数
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+    uint64_t head_seq = 0;
+    uint64_t next_seq = 0;
+    std::unique_ptr<leveldb::Iterator> it(
+        _db->NewIterator(leveldb::ReadOptions()));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        uint64_t seq = 0;
+        if (!decode_key(it->key(), &seq)) {
+            continue;
+        }
+        if (count == 0) {
+            head_seq = seq;
+        }
+        next_seq = seq + 1;
+        ++count;
+        bytes += it->value().size();
+    }
+
+    if (!it->status().ok()) {
+        SPDLOG_ERROR("Failed to scan spill queue at {}: {}", path,
+                     it->status().ToString());
+        _db.reset();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _options = options;
+    _head_seq = count > 0 ? head_seq : next_seq;
+    _next_seq = next_seq;
+    _count = count;
+    _bytes = bytes;
+
+    SPDLOG_INFO("Spill queue opened at {} with {} message(s), {} byte(s)",
+                path, count, bytes);
+    return true;
+}
+
+void SpillQueue::configure(const Options& options) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _options = options;
+}
+
+void SpillQueue::expose(const std::string& prefix) {
+    _size_status.expose(prefix + "_spill_messages");
+    _bytes_status.expose(prefix + "_spill_bytes");
+    _spilled.expose(prefix + "_spilled");
+    _replayed.expose(prefix + "_spill_replayed");
+    _rejected.expose(prefix + "_spill_rejected");
+}
+
+bool SpillQueue::append(const rocketmq::Message& message) {
+    std::string value;
+    encode_value(message, &value);
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_db || _count >= _options.max_messages ||
+        _bytes + value.size() > _options.max_bytes) {
+        _rejected << 1;
+        return false;
+    }
+
+    leveldb::WriteOptions write_options;
+    write_options.sync = _options.sync;
+    leveldb::Status status =
+        _db->Put(write_options, encode_key(_next_seq), value);
+    if (!status.ok()) {
+        SPDLOG_ERROR("Failed to append to spill queue: {}", status.ToString());
+        _rejected << 1;
+        return false;
+    }
+
+    ++_next_seq;
+    ++_count;
+    _bytes += value.size();
+    _spilled << 1;
+    return true;
+}
+
+bool SpillQueue::begin_replay(std::size_t max,
+                              std::vector<Record>* records) {
+    records->clear();
+    if (!_db || empty() || max == 0 ||
+        steady_now_ms() < _replay_after_ms.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    bool expected = false;
+    if (!_replaying.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+
+    uint64_t head_seq = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        head_seq = _head_seq;
+    }
+
+    // 只有重放线程删除记录，队头之后的记录在重放期间保持不变
+    std::unique_ptr<leveldb::Iterator> it(
+        _db->NewIterator(leveldb::ReadOptions()));
+    for (it->Seek(encode_key(head_seq)); it->Valid() && records->size() < max;
+         it->Next()) {
+        Record record;
+        if (!decode_key(it->key(), &record.seq) ||
+            !decode_value(it->value(), &record)) {
+            SPDLOG_ERROR("Corrupted spill record will be dropped");
+            record.corrupted = true;
+        }
+        record.size = it->value().size();
+        records->push_back(std::move(record));
+    }
+
+    if (records->empty()) {
+        _replaying = false;
+        return false;
+    }
+
+    return true;
+}
+
+void SpillQueue::end_replay(const std::vector<Record>& records,
+                            std::size_t replayed) {
+    replayed = std::min(replayed, records.size());
+    if (replayed > 0) {
+        leveldb::WriteBatch batch;
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < replayed; ++i) {
+            batch.Delete(encode_key(records[i].seq));
+            bytes += records[i].size;
+        }
+
+        leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
+        if (status.ok()) {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _head_seq = records[replayed - 1].seq + 1;
+            _count -= replayed;
+            _bytes -= bytes;
+            _replayed << static_cast<int64_t>(replayed);
+        } else {
+            // 删除失败时这些消息会被再次重放
+            SPDLOG_ERROR("Failed to remove replayed spill records: {}",
+                         status.ToString());
+        }
+    }
+
+    if (replayed < records.size()) {
+        std::size_t interval_seconds = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            interval_seconds = _options.replay_retry_interval_seconds;
+        }
+        _replay_after_ms = steady_now_ms() +
+                           static_cast<int64_t>(interval_seconds) * 1000;
+    }
+
+    _replaying = false;
+}
+
+std::string SpillQueue::encode_key(uint64_t seq) {
+    std::string key(8, '\0');
+    for (int i = 7; i >= 0; --i) {
+        key[i] = static_cast<char>(seq & 0xff);
+        seq >>= 8;
+    }
+    return key;
+}
+
+bool SpillQueue::decode_key(const leveldb::Slice& key, uint64_t* seq) {
+    if (key.size() != 8) {
+        return false;
+    }
+
+    *seq = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        *seq = (*seq << 8) | static_cast<uint8_t>(key.data()[i]);
+    }
+    return true;
+}
+
+void SpillQueue::encode_value(const rocketmq::Message& message,
+                              std::string* value) {
+    value->reserve(message.body().size() + 256);
+    value->push_back(static_cast<char>(kFormatVersion));
+
+    int64_t deliver_at_ms = 0;
+    if (message.deliveryTimestamp().time_since_epoch().count()) {
+        deliver_at_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            message.deliveryTimestamp().time_since_epoch())
+                            .count();
+    }
+    put_fixed64(value, static_cast<uint64_t>(deliver_at_ms));
+
+    put_string(value, message.tag());
+    put_string(value, message.traceContext());
+    put_string(value, message.group());
+
+    put_fixed32(value, static_cast<uint32_t>(message.keys().size()));
+    for (const auto& key : message.keys()) {
+        put_string(value, key);
+    }
+
+    put_fixed32(value, static_cast<uint32_t>(message.properties().size()));
+    for (const auto& property : message.properties()) {
+        put_string(value, property.first);
+        put_string(value, property.second);
+    }
+
+    put_string(value, message.body());
+}
+
+bool SpillQueue::decode_value(const leveldb::Slice& value, Record* record) {
+    Reader reader(value);
+
+    uint8_t version = 0;
+    if (!reader.get_byte(&version) || version != kFormatVersion) {
+        return false;
+    }
+
+    uint64_t deliver_at_ms = 0;
+    if (!reader.get_fixed64(&deliver_at_ms) ||
+        !reader.get_string(&record->tag) ||
+        !reader.get_string(&record->trace_context) ||
+        !reader.get_string(&record->group)) {
+        return false;
+    }
+    record->deliver_at_ms = static_cast<int64_t>(deliver_at_ms);
+
+    uint32_t key_count = 0;
+    if (!reader.get_fixed32(&key_count)) {
+        return false;
+    }
+    // 数量来自磁盘数据，损坏时可能极大，逐个读取，读取失败即停止
+    record->keys.clear();
+    for (uint32_t i = 0; i < key_count; ++i) {
+        std::string key;
+        if (!reader.get_string(&key)) {
+            return false;
+        }
+        record->keys.push_back(std::move(key));
+    }
+
+    uint32_t property_count = 0;
+    if (!reader.get_fixed32(&property_count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < property_count; ++i) {
+        std::string key;
+        std::string property;
+        if (!reader.get_string(&key) || !reader.get_string(&property)) {
+            return false;
+        }
+        record->properties.emplace(std::move(key), std::move(property));
+    }
+
+    return reader.get_string(&record->body);
+}
+
+int64_t SpillQueue::steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+std::size_t SpillQueue::get_size(void* queue) {
+    return static_cast<SpillQueue*>(queue)->size();
+}
+
+std::size_t SpillQueue::get_bytes(void* queue) {
+    return static_cast<SpillQueue*>(queue)->bytes();
+}
+
+}    // namespace bmq
\ No newline at end of file
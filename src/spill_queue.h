@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bvar/bvar.h"
+#include "leveldb/db.h"
+#include "rocketmq/Message.h"
+
+namespace bmq {
+
+// 目标主题不可用时的本地落盘队列
+//
+// 发送失败的消息序列化后以递增序号为 key 追加写入 LevelDB，随后即可确认缓冲
+// 队列中的原消息，避免故障期间反复拉取、发送同一批消息。目标恢复后由工作线程
+// 按限流速率从队头依次重放，发送成功的前缀再从 LevelDB 中删除
+class SpillQueue {
+public:
+    struct Options {
+        bool enable{false};
+        std::string path{"./spill"};    // 存储目录，按调度器名称分子目录
+        std::size_t max_messages{1000000};
+        std::size_t max_bytes{1024 * 1024 * 1024};
+        bool sync{false};    // 每次写入都同步落盘
+        // 重放失败后多久再次重放
+        std::size_t replay_retry_interval_seconds{5};
+    };
+
+    // 落盘的消息，重放时据此重建目标消息
+    struct Record {
+        uint64_t seq{0};
+        std::size_t size{0};         // 编码后的字节数
+        bool corrupted{false};       // 无法解析，重放时直接丢弃
+        int64_t deliver_at_ms{0};    // 定时消息的投递时间，0 表示普通消息
+        std::string tag;
+        std::vector<std::string> keys;
+        std::string trace_context;
+        std::string group;
+        std::unordered_map<std::string, std::string> properties;
+        std::string body;
+    };
+
+    SpillQueue();
+
+    ~SpillQueue();
+
+    SpillQueue(const SpillQueue&) = delete;
+    SpillQueue& operator=(const SpillQueue&) = delete;
+
+    // 打开或创建存储，恢复已落盘的消息数和字节数
+    bool open(const std::string& path, const Options& options);
+
+    // 更新容量上限等运行参数，存储路径不变
+    void configure(const Options& options);
+
+    void expose(const std::string& prefix);
+
+    // 追加一条消息，队列已满或写入失败时返回 false
+    bool append(const rocketmq::Message& message);
+
+    // 独占地取出队头至多 max 条记录用于重放
+    // 其他线程正在重放或处于重放退避期时返回 false
+    bool begin_replay(std::size_t max, std::vector<Record>* records);
+
+    // 结束重放：删除前 replayed 条记录
+    // replayed 小于取出的数量说明目标仍不可用，退避一段时间后再重放
+    void end_replay(const std::vector<Record>& records, std::size_t replayed);
+
+    bool empty() const { return _count.load(std::memory_order_relaxed) == 0; }
+
+    std::size_t size() const { return _count.load(std::memory_order_relaxed); }
+
+    std::size_t bytes() const { return _bytes.load(std::memory_order_relaxed); }
+
+private:
+    // 大端序的序号，使 LevelDB 的字节序与序号顺序一致
+    static std::string encode_key(uint64_t seq);
+
+    static bool decode_key(const leveldb::Slice& key, uint64_t* seq);
+
+    static void encode_value(const rocketmq::Message& message,
+                             std::string* value);
+
+    static bool decode_value(const leveldb::Slice& value, Record* record);
+
+    static int64_t steady_now_ms();
+
+    static std::size_t get_size(void* queue);
+
+    static std::size_t get_bytes(void* queue);
+
+private:
+    std::unique_ptr<leveldb::DB> _db;
+    std::mutex _mtx;    // 保护序号分配和容量检查
+    Options _options;
+    uint64_t _head_seq;    // 队头记录的序号
+    uint64_t _next_seq;    // 下一条追加记录的序号
+    std::atomic<std::size_t> _count;
+    std::atomic<std::size_t> _bytes;
+    std::atomic<bool> _replaying;
+    std::atomic<int64_t> _replay_after_ms;    // 退避结束时刻（steady clock）
+
+    bvar::PassiveStatus<std::size_t> _size_status;
+    bvar::PassiveStatus<std::size_t> _bytes_status;
+    bvar::Adder<int64_t> _spilled;     // 落盘的消息数
+    bvar::Adder<int64_t> _replayed;    // 重放成功的消息数
+    bvar::Adder<int64_t> _rejected;    // 队列已满或写入失败而未能落盘的消息数
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace bmq {
+
+// 带版本号的不可变快照
+//
+// 写者每次发布一个新的只读对象并递增版本号；读者在本地缓存快照指针和版本号，
+// 只有版本号变化时才加锁重新获取快照。稳态下读路径只有一次 acquire 读，
+// 不分配内存，也不会修改共享的引用计数
+template <typename T>
+class VersionedSnapshot {
+public:
+    VersionedSnapshot() : _version(0) {}
+
+    VersionedSnapshot(const VersionedSnapshot&) = delete;
+    VersionedSnapshot& operator=(const VersionedSnapshot&) = delete;
+
+    // 发布新的快照，已被读者持有的旧快照在最后一个引用释放时析构
+    void publish(std::shared_ptr<const T> snapshot) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _snapshot.swap(snapshot);
+        _version.fetch_add(1, std::memory_order_release);
+    }
+
+    // 当前快照，未发布时返回空
+    std::shared_ptr<const T> load() const {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _snapshot;
+    }
+
+    // 版本号与 *version 不同时更新本地快照，返回是否发生了更新
+    bool refresh(std::shared_ptr<const T>* snapshot, uint64_t* version) const {
+        if (_version.load(std::memory_order_acquire) == *version) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        *snapshot = _snapshot;
+        *version = _version.load(std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    mutable std::mutex _mtx;
+    std::shared_ptr<const T> _snapshot;
+    std::atomic<uint64_t> _version;
+};
+
+}    // namespace bmq
\ No newline at end of file
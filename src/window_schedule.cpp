@@ -0,0 +1,58 @@
+#include "window_schedule.h"
+
+#include <algorithm>
+
+namespace bmq {
+
+void WindowSchedule::add(int32_t start_second, int32_t end_second,
+                         int32_t window) {
+    _ranges.push_back(Range{std::max(0, start_second),
+                            std::min(kSecondsPerDay, end_second), window});
+}
+
+void WindowSchedule::compile() {
+    std::sort(_ranges.begin(), _ranges.end(),
+              [](const Range& a, const Range& b) { return a.start < b.start; });
+
+    _transitions.clear();
+    _transitions.push_back(Transition{0, -1});
+
+    for (const auto& range : _ranges) {
+        if (range.start >= range.end) {
+            continue;
+        }
+
+        // 与上一个切换点重合时直接覆盖，保证切换点的秒数严格递增
+        if (_transitions.back().second == range.start) {
+            _transitions.back().window = range.window;
+        } else {
+            _transitions.push_back(Transition{range.start, range.window});
+        }
+        _transitions.push_back(Transition{range.end, -1});
+    }
+
+    // 结束于零点的窗口不需要额外的切换点
+    if (_transitions.back().second >= kSecondsPerDay) {
+        _transitions.pop_back();
+    }
+}
+
+int32_t WindowSchedule::lookup(int32_t second_of_day,
+                               int32_t* next_transition) const {
+    // 第一个晚于 second_of_day 的切换点
+    auto next = std::upper_bound(
+        _transitions.begin(), _transitions.end(), second_of_day,
+        [](int32_t second, const Transition& t) { return second < t.second; });
+
+    if (next_transition) {
+        *next_transition =
+            next == _transitions.end() ? kSecondsPerDay : next->second;
+    }
+
+    if (next == _transitions.begin()) {
+        return -1;
+    }
+    return std::prev(next)->window;
+}
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace bmq {
+
+// 预编译的一天内时间窗口切换表
+//
+// 配置加载时把启用的时间窗口展开为按秒排序的切换点列表，每个切换点记录从该
+// 秒起生效的窗口下标（-1 表示不在任何窗口内），查询时二分查找即可同时得到
+// 当前窗口和下一次切换的时刻
+class WindowSchedule {
+public:
+    static constexpr int32_t kSecondsPerDay = 24 * 3600;
+
+    // 添加窗口 [start_second, end_second)，窗口之间不能重叠
+    void add(int32_t start_second, int32_t end_second, int32_t window);
+
+    // 生成切换表，必须在 add 完所有窗口之后调用
+    void compile();
+
+    // 返回 second_of_day 所在的窗口下标，不在窗口内时返回 -1
+    // next_transition 非空时写入下一次切换的秒数（可能等于 kSecondsPerDay）
+    int32_t lookup(int32_t second_of_day, int32_t* next_transition) const;
+
+private:
+    struct Transition {
+        int32_t second;    // 从该秒起生效
+        int32_t window;    // 生效的窗口下标，-1 表示窗口外
+    };
+
+    struct Range {
+        int32_t start;
+        int32_t end;
+        int32_t window;
+    };
+
+    std::vector<Range> _ranges;
+    std::vector<Transition> _transitions;
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -0,0 +1,539 @@
+#include "work_stealing_executor.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+namespace bmq {
+
+class WorkStealingExecutor::Group {
+public:
+    Group(const std::string& name, std::size_t max_concurrency, double weight)
+        : name(name),
+          max_concurrency(std::max<std::size_t>(max_concurrency, 1)),
+          weight(weight > 0 ? weight : 1.0) {}
+
+    const std::string name;
+    const std::size_t max_concurrency;
+    const double weight;
+
+    // 以下字段由执行器的 _mtx 保护
+    std::deque<Task> backlog;    // 等待进入工作线程的任务
+    std::size_t admitted{0};     // 已进入本地队列或正在执行的任务数
+    double pass{0.0};            // stride 调度的虚拟时间
+    bool closed{false};
+};
+
+// 备用线程没有本地队列
+static constexpr std::size_t kNoLocalQueue = static_cast<std::size_t>(-1);
+
+// 当前线程所属的执行器及其工作线程下标
+static thread_local WorkStealingExecutor* t_executor = nullptr;
+static thread_local std::size_t t_worker_index = 0;
+// 当前线程所在阻塞区间的嵌套层数
+static thread_local std::size_t t_blocking_depth = 0;
+
+WorkStealingExecutor::BlockingScope::BlockingScope() : _executor(nullptr) {
+    if (t_executor && t_blocking_depth++ == 0) {
+        _executor = t_executor;
+        _executor->enter_blocking();
+    }
+}
+
+WorkStealingExecutor::BlockingScope::~BlockingScope() {
+    if (t_executor) {
+        --t_blocking_depth;
+    }
+    if (_executor) {
+        _executor->leave_blocking();
+    }
+}
+
+WorkStealingExecutor::WorkStealingExecutor()
+    : _running(false),
+      _queued(0),
+      _idle(0),
+      _virtual_time(0.0),
+      _max_spare_threads(0),
+      _blocked(0),
+      _active_spares(0),
+      _idle_spares(0) {}
+
+WorkStealingExecutor::~WorkStealingExecutor() { stop(); }
+
+bool WorkStealingExecutor::start(std::size_t threads,
+                                 std::size_t max_blocking_threads) {
+    if (_running) {
+        SPDLOG_WARN("WorkStealingExecutor is already running");
+        return false;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _running = true;
+    _max_spare_threads = max_blocking_threads;
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        _workers.emplace_back(new Worker());
+    }
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        _threads.emplace_back(&WorkStealingExecutor::worker_thread_func, this,
+                              i);
+    }
+
+    _timer_thread =
+        std::thread(&WorkStealingExecutor::timer_thread_func, this);
+
+    SPDLOG_INFO("WorkStealingExecutor started with {} thread(s), up to {} "
+                "blocking thread(s)",
+                threads, max_blocking_threads);
+    return true;
+}
+
+void WorkStealingExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (!_running) {
+            return;
+        }
+        _running = false;
+    }
+    _cv.notify_all();
+    _spare_cv.notify_all();
+
+    {
+        std::lock_guard<std::mutex> lock(_timer_mtx);
+    }
+    _timer_cv.notify_all();
+
+    for (auto& thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    _threads.clear();
+
+    // 停止后不再创建备用线程，可以在锁外等待
+    std::vector<std::thread> spare_threads;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        spare_threads.swap(_spare_threads);
+    }
+    for (auto& thread : spare_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    if (_timer_thread.joinable()) {
+        _timer_thread.join();
+    }
+
+    // 丢弃未执行的任务，释放分组名额，避免 close_group 永久等待
+    std::vector<Entry> dropped;
+    for (auto& worker : _workers) {
+        for (auto& entry : worker->tasks) {
+            dropped.push_back(std::move(entry));
+        }
+    }
+    _workers.clear();
+    _queued = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_timer_mtx);
+        _timers.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        for (const auto& entry : dropped) {
+            --entry.group->admitted;
+        }
+        for (const auto& group : _groups) {
+            group->backlog.clear();
+        }
+    }
+    _group_cv.notify_all();
+}
+
+std::shared_ptr<WorkStealingExecutor::Group>
+WorkStealingExecutor::create_group(const std::string& name,
+                                   std::size_t max_concurrency,
+                                   double weight) {
+    auto group = std::make_shared<Group>(name, max_concurrency, weight);
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    // 新分组从当前虚拟时间开始，不会因为来得晚而获得额外份额
+    group->pass = _virtual_time;
+    _groups.push_back(group);
+    return group;
+}
+
+void WorkStealingExecutor::close_group(const std::shared_ptr<Group>& group) {
+    std::deque<Task> dropped;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        group->closed = true;
+        dropped.swap(group->backlog);
+    }
+
+    std::vector<Entry> dropped_timers;
+    {
+        std::lock_guard<std::mutex> lock(_timer_mtx);
+        for (auto it = _timers.begin(); it != _timers.end();) {
+            if (it->second.group == group) {
+                dropped_timers.push_back(std::move(it->second));
+                it = _timers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // 本地队列中的任务会被工作线程跳过，只需等待正在执行的任务
+    std::unique_lock<std::mutex> lock(_mtx);
+    _group_cv.wait(lock, [&group] { return group->admitted == 0; });
+    _groups.erase(std::remove(_groups.begin(), _groups.end(), group),
+                  _groups.end());
+}
+
+bool WorkStealingExecutor::submit(const std::shared_ptr<Group>& group,
+                                  Task task) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (!_running || group->closed) {
+        return false;
+    }
+
+    // 工作线程内提交且分组还有名额时直接进入本地队列，保持缓存局部性
+    if (t_executor == this && t_worker_index != kNoLocalQueue &&
+        group->backlog.empty() && group->admitted < group->max_concurrency) {
+        ++group->admitted;
+        lock.unlock();
+        push_local(t_worker_index, Entry{group, std::move(task)});
+        return true;
+    }
+
+    group->backlog.push_back(std::move(task));
+    if (group->admitted < group->max_concurrency) {
+        if (_idle > 0) {
+            _cv.notify_one();
+        } else {
+            // 工作线程都在忙或阻塞，交给顶替阻塞线程的备用线程
+            notify_spare_locked();
+        }
+    }
+    return true;
+}
+
+bool WorkStealingExecutor::submit_after(const std::shared_ptr<Group>& group,
+                                        std::chrono::milliseconds delay,
+                                        Task task) {
+    if (delay.count() <= 0) {
+        return submit(group, std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (!_running || group->closed) {
+            return false;
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + delay;
+    bool earliest = false;
+    {
+        std::lock_guard<std::mutex> lock(_timer_mtx);
+        auto it = _timers.emplace(deadline, Entry{group, std::move(task)});
+        earliest = it == _timers.begin();
+    }
+
+    if (earliest) {
+        _timer_cv.notify_one();
+    }
+    return true;
+}
+
+void WorkStealingExecutor::wake(const std::shared_ptr<Group>& group) {
+    std::vector<Entry> due;
+    {
+        std::lock_guard<std::mutex> lock(_timer_mtx);
+        for (auto it = _timers.begin(); it != _timers.end();) {
+            if (it->second.group == group) {
+                due.push_back(std::move(it->second));
+                it = _timers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto& entry : due) {
+        submit(entry.group, std::move(entry.task));
+    }
+}
+
+void WorkStealingExecutor::worker_thread_func(std::size_t index) {
+    t_executor = this;
+    t_worker_index = index;
+
+    Entry entry;
+    while (_running) {
+        if (next_task(index, &entry)) {
+            run(&entry);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mtx);
+        if (!_running) {
+            break;
+        }
+
+        // 先登记为空闲再检查，与 push_local 中先入队再检查空闲数配对，
+        // 保证不会错过唤醒
+        ++_idle;
+        if (_queued == 0 && !has_runnable_group_locked()) {
+            _cv.wait(lock);
+        }
+        --_idle;
+    }
+
+    t_executor = nullptr;
+}
+
+void WorkStealingExecutor::spare_thread_func() {
+    t_executor = this;
+    t_worker_index = kNoLocalQueue;
+
+    Entry entry;
+    std::unique_lock<std::mutex> lock(_mtx);
+    while (_running) {
+        // 阻塞区间结束后顶替名额收回，正在执行的任务完成后即停止取任务
+        if (_active_spares < _blocked &&
+            (_queued > 0 || has_runnable_group_locked())) {
+            ++_active_spares;
+            lock.unlock();
+            if (steal(kNoLocalQueue, &entry) || take_from_groups(&entry)) {
+                run(&entry);
+            }
+            lock.lock();
+            --_active_spares;
+            continue;
+        }
+
+        ++_idle_spares;
+        _spare_cv.wait(lock);
+        --_idle_spares;
+    }
+
+    t_executor = nullptr;
+}
+
+void WorkStealingExecutor::enter_blocking() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    ++_blocked;
+    if (!_running || _active_spares >= _blocked) {
+        return;
+    }
+
+    if (_idle_spares > 0) {
+        _spare_cv.notify_one();
+    } else if (_spare_threads.size() < _max_spare_threads) {
+        _spare_threads.emplace_back(&WorkStealingExecutor::spare_thread_func,
+                                    this);
+    }
+}
+
+void WorkStealingExecutor::leave_blocking() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    --_blocked;
+}
+
+void WorkStealingExecutor::notify_spare_locked() {
+    if (_idle_spares > 0 && _active_spares < _blocked) {
+        _spare_cv.notify_one();
+    }
+}
+
+void WorkStealingExecutor::timer_thread_func() {
+    std::unique_lock<std::mutex> lock(_timer_mtx);
+    while (_running) {
+        if (_timers.empty()) {
+            _timer_cv.wait(lock);
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (_timers.begin()->first > now) {
+            _timer_cv.wait_until(lock, _timers.begin()->first);
+            continue;
+        }
+
+        std::vector<Entry> due;
+        while (!_timers.empty() && _timers.begin()->first <= now) {
+            due.push_back(std::move(_timers.begin()->second));
+            _timers.erase(_timers.begin());
+        }
+
+        lock.unlock();
+        for (auto& entry : due) {
+            submit(entry.group, std::move(entry.task));
+        }
+        lock.lock();
+    }
+}
+
+bool WorkStealingExecutor::next_task(std::size_t index, Entry* entry) {
+    return pop_local(index, entry) || steal(index, entry) ||
+           take_from_groups(entry);
+}
+
+bool WorkStealingExecutor::pop_local(std::size_t index, Entry* entry) {
+    Worker& worker = *_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+
+    *entry = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --_queued;
+    return true;
+}
+
+bool WorkStealingExecutor::steal(std::size_t index, Entry* entry) {
+    if (_queued == 0) {
+        return false;
+    }
+
+    // 从下一个线程开始轮询，避免所有空闲线程争抢同一个队列；
+    // 备用线程没有本地队列，轮询所有工作线程
+    std::size_t count = _workers.size();
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t victim_index = (index + 1 + i) % count;
+        if (victim_index == index) {
+            continue;
+        }
+
+        Worker& victim = *_workers[victim_index];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            *entry = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --_queued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool WorkStealingExecutor::take_from_groups(Entry* entry) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    // 选择 pass 最小的可执行分组，每取出一个任务 pass 增加 1/weight，
+    // 长期来看各分组获得的任务数与权重成正比
+    Group* selected = nullptr;
+    double selected_pass = 0.0;
+    for (const auto& group : _groups) {
+        if (group->closed || group->backlog.empty() ||
+            group->admitted >= group->max_concurrency) {
+            continue;
+        }
+
+        // 空闲过的分组从当前虚拟时间开始，不累积份额
+        double pass = std::max(group->pass, _virtual_time);
+        if (!selected || pass < selected_pass) {
+            selected = group.get();
+            selected_pass = pass;
+        }
+    }
+
+    if (!selected) {
+        return false;
+    }
+
+    for (const auto& group : _groups) {
+        if (group.get() == selected) {
+            entry->group = group;
+            break;
+        }
+    }
+
+    entry->task = std::move(selected->backlog.front());
+    selected->backlog.pop_front();
+    ++selected->admitted;
+    _virtual_time = selected_pass;
+    selected->pass = selected_pass + 1.0 / selected->weight;
+    return true;
+}
+
+bool WorkStealingExecutor::has_runnable_group_locked() const {
+    for (const auto& group : _groups) {
+        if (!group->closed && !group->backlog.empty() &&
+            group->admitted < group->max_concurrency) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingExecutor::push_local(std::size_t index, Entry entry) {
+    {
+        Worker& worker = *_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mtx);
+        worker.tasks.push_back(std::move(entry));
+    }
+    ++_queued;
+
+    // 有空闲线程时唤醒一个来窃取，没有时交给顶替阻塞线程的备用线程
+    if (_idle > 0) {
+        notify_idle();
+    } else if (_blocked > 0) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        notify_spare_locked();
+    }
+}
+
+void WorkStealingExecutor::run(Entry* entry) {
+    bool closed = false;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        closed = entry->group->closed;
+    }
+
+    // 已关闭分组的任务直接丢弃
+    if (!closed) {
+        try {
+            entry->task();
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("Task of group '{}' threw exception: {}",
+                         entry->group->name, e.what());
+        }
+    }
+
+    entry->task = nullptr;
+    std::shared_ptr<Group> group = std::move(entry->group);
+
+    // 分组名额释放后由当前线程在下一轮取出该分组的后续任务
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        --group->admitted;
+        closed = group->closed;
+    }
+
+    if (closed) {
+        _group_cv.notify_all();
+    }
+}
+
+void WorkStealingExecutor::notify_idle() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+    }
+    _cv.notify_one();
+}
+
+}    // namespace bmq
\ No newline at end of file
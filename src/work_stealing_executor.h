@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bmq {
+
+// 进程级的工作窃取执行器，由 SchedulerManager 持有，所有调度器共享
+//
+// 每个工作线程有一个本地双端队列：线程内提交的任务压入本地队列尾部并从尾部
+// 取出，空闲线程从其他线程队列的头部窃取。线程外提交的任务和到期的定时任务
+// 先进入所属分组的等待队列，空闲线程按权重（stride 调度）从各分组中取出。
+// 分组限制同时排队和执行的任务数，窗口外的调度器不占用线程，线程随活动窗口
+// 在调度器之间流动
+//
+// 工作线程只应执行计算。任务中无法避免的阻塞调用（长轮询、同步发送、等待
+// 令牌等）需要放在 BlockingScope 中：阻塞期间由备用线程池中的线程顶替执行
+// 其他任务，保证同时执行计算的线程数不少于 threads，阻塞的调度器不会占满
+// 执行器而饿死其他调度器
+class WorkStealingExecutor {
+public:
+    using Task = std::function<void()>;
+
+    // 任务分组，对应一个调度器
+    class Group;
+
+    // 标记任务中的阻塞区间，在执行器线程之外构造时不做任何事，可以嵌套
+    class BlockingScope {
+    public:
+        BlockingScope();
+        ~BlockingScope();
+
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+
+    private:
+        WorkStealingExecutor* _executor;    // 最外层区间所属的执行器
+    };
+
+    WorkStealingExecutor();
+
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+    // 启动 threads 个工作线程（0 表示 CPU 核数），
+    // 阻塞区间内顶替执行的备用线程按需创建，最多 max_blocking_threads 个
+    bool start(std::size_t threads, std::size_t max_blocking_threads = 64);
+
+    // 停止所有线程，未执行的任务被丢弃
+    void stop();
+
+    // 创建任务分组：max_concurrency 为同时排队和执行的任务数上限，
+    // weight 为线程不足时分配给该分组的相对份额
+    std::shared_ptr<Group> create_group(const std::string& name,
+                                        std::size_t max_concurrency,
+                                        double weight);
+
+    // 关闭分组：丢弃未执行的任务，等待执行中的任务完成
+    // 不能在该分组的任务中调用
+    void close_group(const std::shared_ptr<Group>& group);
+
+    // 提交任务，分组已关闭或执行器未运行时返回 false
+    bool submit(const std::shared_ptr<Group>& group, Task task);
+
+    // delay 后提交任务，wake() 可提前触发
+    bool submit_after(const std::shared_ptr<Group>& group,
+                      std::chrono::milliseconds delay, Task task);
+
+    // 立即提交分组中所有未到期的定时任务
+    void wake(const std::shared_ptr<Group>& group);
+
+    std::size_t thread_count() const { return _workers.size(); }
+
+private:
+    struct Entry {
+        std::shared_ptr<Group> group;
+        Task task;
+    };
+
+    // 工作线程的本地队列，独占缓存行
+    struct alignas(64) Worker {
+        std::mutex mtx;
+        std::deque<Entry> tasks;
+    };
+
+    void worker_thread_func(std::size_t index);
+
+    // 备用线程：只在阻塞区间数多于正在顶替的备用线程数时取任务执行
+    void spare_thread_func();
+
+    void timer_thread_func();
+
+    void enter_blocking();
+
+    void leave_blocking();
+
+    // 有空闲的备用线程且顶替名额未用完时唤醒一个，调用方持有 _mtx
+    void notify_spare_locked();
+
+    // 依次尝试本地队列、窃取、分组等待队列
+    bool next_task(std::size_t index, Entry* entry);
+
+    bool pop_local(std::size_t index, Entry* entry);
+
+    bool steal(std::size_t index, Entry* entry);
+
+    // 按 stride 调度从等待队列最靠前的分组中取出一个任务
+    bool take_from_groups(Entry* entry);
+
+    // 存在可执行任务的分组，调用方持有 _mtx
+    bool has_runnable_group_locked() const;
+
+    void push_local(std::size_t index, Entry entry);
+
+    void run(Entry* entry);
+
+    // 唤醒一个空闲的工作线程
+    void notify_idle();
+
+private:
+    std::atomic<bool> _running;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<std::size_t> _queued;    // 本地队列中的任务总数
+    std::atomic<std::size_t> _idle;      // 等待任务的工作线程数
+
+    // 分组状态
+    std::mutex _mtx;
+    std::condition_variable _cv;          // 工作线程等待任务
+    std::condition_variable _group_cv;    // close_group 等待任务完成
+    std::vector<std::shared_ptr<Group>> _groups;
+    double _virtual_time;    // 最近一次取出任务的分组的 pass
+
+    // 备用线程，由 _mtx 保护
+    std::condition_variable _spare_cv;
+    std::vector<std::thread> _spare_threads;
+    std::size_t _max_spare_threads;
+    // 处于阻塞区间的线程数，在 _mtx 内修改，push_local 在锁外读取
+    std::atomic<std::size_t> _blocked;
+    std::size_t _active_spares;    // 正在顶替执行任务的备用线程数
+    std::size_t _idle_spares;      // 等待顶替名额或任务的备用线程数
+
+    // 定时任务
+    std::thread _timer_thread;
+    std::mutex _timer_mtx;
+    std::condition_variable _timer_cv;
+    std::multimap<std::chrono::steady_clock::time_point, Entry> _timers;
+};
+
+}    // namespace bmq
\ No newline at end of file
@@ -38,6 +38,12 @@ enum class ErrorCode : int {
    */
   BadRequestAsyncPubFifoMessage = 10100,
 
+  /**
+   * @brief An earlier FIFO message of the same message group failed for good; later messages of the group are rejected
+   * until FifoProducer#resume() is called, so that they cannot overtake it.
+   */
+  FifoGroupFenced = 10101,
+
   /**
    * @brief 102XX is used for client side error.
    *
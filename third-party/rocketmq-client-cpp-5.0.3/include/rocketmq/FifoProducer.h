@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
 #include <vector>
@@ -37,6 +38,13 @@ public:
 
   void send(MessageConstPtr message, SendCallback callback);
 
+  /**
+   * @brief Once a message exhausts its retry attempts, its message group is fenced: the queued and subsequently sent
+   * messages of the group complete with ErrorCode::FifoGroupFenced without being sent. Call this before re-sending the
+   * failed message to let the group through again.
+   */
+  void resume(const std::string& group);
+
 private:
   std::shared_ptr<FifoProducerImpl> impl_;
 
@@ -58,11 +66,22 @@ public:
 
   FifoProducerBuilder& withConcurrency(std::size_t concurrency);
 
+  /**
+   * @brief Re-send a failed message at most max_attempts times, backing off exponentially from initial_backoff up to
+   * max_backoff, then report the failure through the send callback. By default failed messages are retried forever
+   * without backoff and the callback only ever sees successes.
+   */
+  FifoProducerBuilder& withRetryPolicy(std::size_t max_attempts, std::chrono::milliseconds initial_backoff,
+                                       std::chrono::milliseconds max_backoff);
+
   FifoProducer build();
 
 private:
   std::shared_ptr<FifoProducerImpl> impl_;
   std::shared_ptr<ProducerImpl> producer_impl_;
+  std::size_t max_attempts_{0};
+  std::chrono::milliseconds initial_backoff_{0};
+  std::chrono::milliseconds max_backoff_{0};
 };
 
 ROCKETMQ_NAMESPACE_END
\ No newline at end of file
@@ -89,7 +89,8 @@ public:
   }
 
   const std::string& body() const {
-    return body_;
+    static const std::string empty;
+    return body_ ? *body_ : empty;
   }
 
   const std::unordered_map<std::string, std::string>& properties() const {
@@ -124,7 +125,8 @@ private:
   std::string born_host_;
   std::chrono::system_clock::time_point born_time_{std::chrono::system_clock::now()};
   std::chrono::system_clock::time_point delivery_timestamp_;
-  std::string body_;
+  // Immutable once set, so that forwarded messages can share the buffer with the message they are built from.
+  std::shared_ptr<const std::string> body_;
   std::unordered_map<std::string, std::string> properties_;
   std::string group_;
   Extension extension_;
@@ -161,6 +163,18 @@ public:
    */
   MessageBuilder& availableAfter(std::chrono::system_clock::time_point delivery_timepoint);
 
+  /**
+   * @brief Carry over tag, keys, trace context, body, user properties and message group of a received message, e.g.
+   * when forwarding it to another topic.
+   *
+   * The body buffer is shared with the source rather than copied; the source is left untouched and can still be
+   * acknowledged or read.
+   *
+   * @param source Message received from a consumer.
+   * @return MessageBuilder&
+   */
+  MessageBuilder& forwardFrom(const Message& source);
+
   MessageConstPtr build();
 
 private:
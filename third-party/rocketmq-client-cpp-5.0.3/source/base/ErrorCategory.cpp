@@ -42,6 +42,9 @@ std::string ErrorCategory::message(int code) const {
     case ErrorCode::BadRequestAsyncPubFifoMessage:
       return "Publishing of FIFO messages is only allowed synchronously";
 
+    case ErrorCode::FifoGroupFenced:
+      return "An earlier message of the FIFO message group failed to send. Resume the group after it is re-sent";
+
     case ErrorCode::Unauthorized:
       return "Authentication failed. Possibly caused by invalid credentials.";
 
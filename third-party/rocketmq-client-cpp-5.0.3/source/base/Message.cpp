@@ -55,7 +55,7 @@ MessageBuilder& MessageBuilder::withTraceContext(std::string trace_context) {
 }
 
 MessageBuilder& MessageBuilder::withBody(std::string body) {
-  message_->body_.swap(body);
+  message_->body_ = std::make_shared<const std::string>(std::move(body));
   return *this;
 }
 
@@ -74,6 +74,16 @@ MessageBuilder& MessageBuilder::availableAfter(std::chrono::system_clock::time_p
   return *this;
 }
 
+MessageBuilder& MessageBuilder::forwardFrom(const Message& source) {
+  message_->tag_ = source.tag_;
+  message_->keys_ = source.keys_;
+  message_->trace_context_ = source.trace_context_;
+  message_->properties_ = source.properties_;
+  message_->group_ = source.group_;
+  message_->body_ = source.body_;
+  return *this;
+}
+
 MessageConstPtr MessageBuilder::build() {
   return std::move(message_);
 }
@@ -53,4 +53,30 @@ TEST_F(MessageBuilderTest, testBuilder2) {
   }
 }
 
+TEST_F(MessageBuilderTest, testForwardFrom) {
+  std::unordered_map<std::string, std::string> properties{{"k", "v"}};
+  MessageConstSharedPtr source = Message::newBuilder()
+                                     .withTopic(topic_)
+                                     .withTag(tag_)
+                                     .withKeys(keys_)
+                                     .withBody(body_)
+                                     .withGroup(group_)
+                                     .withProperties(properties)
+                                     .withTraceContext("trace")
+                                     .build();
+  const char* data = source->body().data();
+
+  MessageConstPtr message = Message::newBuilder().withTopic("TargetTopic").forwardFrom(*source).build();
+  ASSERT_EQ("TargetTopic", message->topic());
+  ASSERT_EQ(tag_, message->tag());
+  ASSERT_TRUE(keys_ == message->keys());
+  ASSERT_EQ(body_, message->body());
+  ASSERT_EQ(data, message->body().data());
+  ASSERT_EQ(group_, message->group());
+  ASSERT_TRUE(properties == message->properties());
+  ASSERT_EQ("trace", message->traceContext());
+  ASSERT_EQ(data, source->body().data());
+  ASSERT_EQ(topic_, source->topic());
+}
+
 ROCKETMQ_NAMESPACE_END
\ No newline at end of file
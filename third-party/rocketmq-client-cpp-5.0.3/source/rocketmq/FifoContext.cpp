@@ -27,6 +27,7 @@ FifoContext::FifoContext(MessageConstPtr message, SendCallback callback)
 FifoContext::FifoContext(FifoContext&& rhs) noexcept {
   this->message = std::move(rhs.message);
   this->callback = rhs.callback;
+  this->attempts = rhs.attempts;
 }
 
 ROCKETMQ_NAMESPACE_END
\ No newline at end of file
@@ -56,7 +56,17 @@ FifoProducerBuilder& FifoProducerBuilder::withConcurrency(std::size_t concurrenc
   return *this;
 }
 
+FifoProducerBuilder& FifoProducerBuilder::withRetryPolicy(std::size_t max_attempts,
+                                                          std::chrono::milliseconds initial_backoff,
+                                                          std::chrono::milliseconds max_backoff) {
+  max_attempts_ = max_attempts;
+  initial_backoff_ = initial_backoff;
+  max_backoff_ = max_backoff;
+  return *this;
+}
+
 FifoProducer FifoProducerBuilder::build() {
+  impl_->withRetryPolicy(max_attempts_, initial_backoff_, max_backoff_);
   FifoProducer fifo_producer(this->impl_);
   fifo_producer.start();
   return fifo_producer;
@@ -70,4 +80,8 @@ void FifoProducer::send(MessageConstPtr message, SendCallback callback) {
   impl_->send(std::move(message), callback);
 }
 
+void FifoProducer::resume(const std::string& group) {
+  impl_->resume(group);
+}
+
 ROCKETMQ_NAMESPACE_END
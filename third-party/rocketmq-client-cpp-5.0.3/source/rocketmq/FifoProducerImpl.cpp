@@ -34,4 +34,9 @@ void FifoProducerImpl::send(MessageConstPtr message, SendCallback callback) {
   partitions_[slot]->add(std::move(context));
 }
 
+void FifoProducerImpl::resume(const std::string& group) {
+  std::size_t slot = hash_fn_(group) % concurrency_;
+  partitions_[slot]->resume(group);
+}
+
 ROCKETMQ_NAMESPACE_END
\ No newline at end of file
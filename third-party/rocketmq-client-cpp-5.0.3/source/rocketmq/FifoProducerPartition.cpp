@@ -18,11 +18,14 @@
 
 #include "absl/synchronization/mutex.h"
 
+#include <algorithm>
 #include <atomic>
+#include <iterator>
 #include <memory>
 #include <system_error>
 
 #include "FifoContext.h"
+#include "rocketmq/ErrorCode.h"
 #include "rocketmq/Message.h"
 #include "rocketmq/RocketMQ.h"
 #include "rocketmq/SendCallback.h"
@@ -34,74 +37,163 @@ ROCKETMQ_NAMESPACE_BEGIN
 void FifoProducerPartition::add(FifoContext&& context) {
   {
     absl::MutexLock lk(&messages_mtx_);
-    messages_.emplace_back(std::move(context));
-    RMQLOG_DEBUG("{} has {} pending messages after #add", name_, messages_.size());
+    if (fenced_groups_.count(context.message->group()) == 0) {
+      messages_.emplace_back(std::move(context));
+      RMQLOG_DEBUG("{} has {} pending messages after #add", name_, messages_.size());
+    }
+  }
+
+  // Rejected above: complete it outside of the lock, the callback may re-enter #add
+  if (context.message) {
+    reject(context);
+    return;
   }
 
   trySend();
 }
 
+void FifoProducerPartition::resume(const std::string& group) {
+  absl::MutexLock lk(&messages_mtx_);
+  if (fenced_groups_.erase(group)) {
+    RMQLOG_INFO("{}: message group {} resumed", name_, group);
+  }
+}
+
+void FifoProducerPartition::reject(FifoContext& context) {
+  SendReceipt receipt;
+  receipt.message = std::move(context.message);
+  std::error_code ec = ErrorCode::FifoGroupFenced;
+  context.callback(ec, receipt);
+}
+
 void FifoProducerPartition::trySend() {
-  bool expected = false;
-  if (inflight_.compare_exchange_strong(expected, true, std::memory_order_relaxed)) {
-    absl::MutexLock lk(&messages_mtx_);
+  while (true) {
+    bool expected = false;
+    if (!inflight_.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+      RMQLOG_DEBUG("There is an inflight message");
+      return;
+    }
+
+    MessageConstPtr message;
+    SendCallback send_callback;
+    std::size_t attempts = 0;
+    {
+      absl::MutexLock lk(&messages_mtx_);
+      if (!messages_.empty()) {
+        FifoContext& ctx = messages_.front();
+        message = std::move(ctx.message);
+        send_callback = ctx.callback;
+        attempts = ctx.attempts;
+        messages_.pop_front();
+        RMQLOG_DEBUG("In addition to the inflight one, there is {} messages pending in {}", messages_.size(), name_);
+      }
+    }
 
-    if (messages_.empty()) {
-      RMQLOG_DEBUG("There is no more messages to send");
+    if (message) {
+      std::shared_ptr<FifoProducerPartition> partition = shared_from_this();
+      auto fifo_callback = [=](const std::error_code& ec, const SendReceipt& receipt) mutable {
+        partition->onComplete(ec, receipt, send_callback, attempts + 1);
+      };
+      // Send outside of the lock: the callback may run synchronously and re-enter #add or #onComplete
+      RMQLOG_DEBUG("Sending FIFO message from {}", name_);
+      producer_->send(std::move(message), fifo_callback);
       return;
     }
 
-    FifoContext& ctx = messages_.front();
-    MessageConstPtr message = std::move(ctx.message);
-    SendCallback send_callback = ctx.callback;
-
-    std::shared_ptr<FifoProducerPartition> partition = shared_from_this();
-    auto fifo_callback = [=](const std::error_code& ec, const SendReceipt& receipt) mutable {
-      partition->onComplete(ec, receipt, send_callback);
-    };
-    RMQLOG_DEBUG("Sending FIFO message from {}", name_);
-    producer_->send(std::move(message), fifo_callback);
-    messages_.pop_front();
-    RMQLOG_DEBUG("In addition to the inflight one, there is {} messages pending in {}", messages_.size(), name_);
-  } else {
-    RMQLOG_DEBUG("There is an inflight message");
+    // Nothing to send. Release the inflight flag, then check again: a message added after the list was observed empty
+    // but before the flag was released would otherwise never be sent.
+    RMQLOG_DEBUG("There is no more messages to send");
+    inflight_.store(false, std::memory_order_release);
+    {
+      absl::MutexLock lk(&messages_mtx_);
+      if (messages_.empty()) {
+        return;
+      }
+    }
   }
 }
 
-void FifoProducerPartition::onComplete(const std::error_code& ec, const SendReceipt& receipt, SendCallback& callback) {
+void FifoProducerPartition::onComplete(const std::error_code& ec, const SendReceipt& receipt, SendCallback& callback,
+                                       std::size_t attempts) {
   if (ec) {
-    RMQLOG_INFO("{} completed with a failure: {}", name_, ec.message());
+    RMQLOG_INFO("{} completed with a failure after {} attempt(s): {}", name_, attempts, ec.message());
   } else {
     RMQLOG_DEBUG("{} completed OK", name_);
   }
 
   if (!ec) {
     callback(ec, receipt);
-    // update inflight status
-    bool expected = true;
-    if (inflight_.compare_exchange_strong(expected, false, std::memory_order_relaxed)) {
-      trySend();
-    } else {
-      RMQLOG_ERROR("{}: Unexpected inflight status", name_);
+    releaseInflight();
+    return;
+  }
+
+  // Out of attempts: fence the message group so that its later messages cannot overtake the failed one, report the
+  // failure and move on to the other groups of the partition
+  if (max_attempts_ > 0 && attempts >= max_attempts_) {
+    std::list<FifoContext> fenced;
+    if (receipt.message && !receipt.message->group().empty()) {
+      const std::string& group = receipt.message->group();
+      absl::MutexLock lk(&messages_mtx_);
+      fenced_groups_.insert(group);
+      for (auto it = messages_.begin(); it != messages_.end();) {
+        auto next = std::next(it);
+        if (it->message->group() == group) {
+          fenced.splice(fenced.end(), messages_, it);
+        }
+        it = next;
+      }
+      RMQLOG_WARN("{}: message group {} fenced, {} queued message(s) rejected", name_, group, fenced.size());
+    }
+
+    callback(ec, receipt);
+    for (auto& context : fenced) {
+      reject(context);
     }
+    releaseInflight();
     return;
   }
 
-  // Put the message back to the front of the list
   SendReceipt& receipt_mut = const_cast<SendReceipt&>(receipt);
   FifoContext retry_context(std::move(receipt_mut.message), callback);
+  retry_context.attempts = attempts;
+
+  std::chrono::milliseconds backoff = backoffOf(attempts);
+  if (backoff.count() <= 0) {
+    resend(std::move(retry_context));
+    return;
+  }
+
+  // Keep the inflight flag during the backoff so that later messages of the partition keep waiting behind this one
+  std::shared_ptr<FifoProducerPartition> partition = shared_from_this();
+  auto context = std::make_shared<FifoContext>(std::move(retry_context));
+  producer_->schedule(
+      name_ + "-retry", [partition, context]() { partition->resend(std::move(*context)); }, backoff);
+}
+
+void FifoProducerPartition::resend(FifoContext&& context) {
   {
     absl::MutexLock lk(&messages_mtx_);
-    messages_.emplace_front(std::move(retry_context));
+    messages_.emplace_front(std::move(context));
   }
 
-  // Update inflight status
+  releaseInflight();
+}
+
+void FifoProducerPartition::releaseInflight() {
   bool expected = true;
-  if (inflight_.compare_exchange_strong(expected, false, std::memory_order_relaxed)) {
+  if (inflight_.compare_exchange_strong(expected, false, std::memory_order_acq_rel)) {
     trySend();
   } else {
-    RMQLOG_ERROR("Unexpected inflight status");
+    RMQLOG_ERROR("{}: Unexpected inflight status", name_);
+  }
+}
+
+std::chrono::milliseconds FifoProducerPartition::backoffOf(std::size_t attempts) const {
+  std::chrono::milliseconds backoff = initial_backoff_;
+  for (std::size_t i = 1; i < attempts && backoff < max_backoff_; i++) {
+    backoff *= 2;
   }
+  return std::min(backoff, std::max(max_backoff_, initial_backoff_));
 }
 
 ROCKETMQ_NAMESPACE_END
@@ -430,8 +430,9 @@ void SimpleConsumerImpl::changeInvisibleDuration(const Message& message, std::st
     callback(ec, server_receipt_handle);
   };
 
-  manager()->changeInvisibleDuration(
-      message.extension().target_endpoint, metadata, request, duration, cb);
+  // The new invisible duration may be shorter than a round trip (or zero), so it must not double as the RPC timeout.
+  manager()->changeInvisibleDuration(message.extension().target_endpoint, metadata, request,
+                                     absl::ToChronoMilliseconds(client_config_.request_timeout), cb);
 }
 
 ROCKETMQ_NAMESPACE_END
\ No newline at end of file
@@ -16,6 +16,8 @@
  */
 #pragma once
 
+#include <cstddef>
+
 #include "rocketmq/Message.h"
 #include "rocketmq/RocketMQ.h"
 #include "rocketmq/SendCallback.h"
@@ -25,6 +27,8 @@ ROCKETMQ_NAMESPACE_BEGIN
 struct FifoContext {
   MessageConstPtr message;
   SendCallback callback;
+  // Number of failed send attempts so far
+  std::size_t attempts{0};
 
   FifoContext(MessageConstPtr message, SendCallback callback);
 
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
 #include <vector>
@@ -39,6 +40,15 @@ public:
 
   void send(MessageConstPtr message, SendCallback callback);
 
+  void resume(const std::string& group);
+
+  void withRetryPolicy(std::size_t max_attempts, std::chrono::milliseconds initial_backoff,
+                       std::chrono::milliseconds max_backoff) {
+    for (auto& partition : partitions_) {
+      partition->withRetryPolicy(max_attempts, initial_backoff, max_backoff);
+    }
+  }
+
   std::shared_ptr<ProducerImpl>& internalProducer() {
     return producer_;
   }
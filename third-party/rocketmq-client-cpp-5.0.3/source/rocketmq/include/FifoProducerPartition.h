@@ -19,12 +19,15 @@
 #include "absl/base/internal/thread_annotations.h"
 
 #include <atomic>
+#include <chrono>
 #include <list>
 #include <memory>
+#include <string>
 #include <system_error>
 
 #include "FifoContext.h"
 #include "ProducerImpl.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "rocketmq/SendCallback.h"
@@ -42,14 +45,48 @@ public:
 
   void trySend() LOCKS_EXCLUDED(messages_mtx_);
 
-  void onComplete(const std::error_code& ec, const SendReceipt& receipt, SendCallback& callback);
+  void onComplete(const std::error_code& ec, const SendReceipt& receipt, SendCallback& callback,
+                  std::size_t attempts);
+
+  /**
+   * @brief Bound the retries of a failed message.
+   *
+   * A failed message stays at the head of the partition, blocking the messages behind it, and is re-sent after
+   * initial_backoff * 2^(attempt - 1), capped at max_backoff. Once max_attempts sends have failed, the callback is
+   * invoked with the error and the message group is fenced: its queued messages, and those added later, complete with
+   * ErrorCode::FifoGroupFenced instead of overtaking the failed one, until #resume is called for the group. Other
+   * groups of the partition move on. max_attempts == 0 retries forever.
+   */
+  void withRetryPolicy(std::size_t max_attempts, std::chrono::milliseconds initial_backoff,
+                       std::chrono::milliseconds max_backoff) {
+    max_attempts_ = max_attempts;
+    initial_backoff_ = initial_backoff;
+    max_backoff_ = max_backoff;
+  }
+
+  // Let a fenced message group through again
+  void resume(const std::string& group) LOCKS_EXCLUDED(messages_mtx_);
 
 private:
+  // Complete a message of a fenced group without sending it
+  static void reject(FifoContext& context);
+
+  // Put a message back to the head of the partition and resume sending
+  void resend(FifoContext&& context) LOCKS_EXCLUDED(messages_mtx_);
+
+  void releaseInflight();
+
+  std::chrono::milliseconds backoffOf(std::size_t attempts) const;
+
   std::shared_ptr<ProducerImpl> producer_;
   std::list<FifoContext> messages_ GUARDED_BY(messages_mtx_);
+  absl::flat_hash_set<std::string> fenced_groups_ GUARDED_BY(messages_mtx_);
   absl::Mutex messages_mtx_;
   std::atomic_bool inflight_{false};
   std::string name_;
+  std::size_t max_attempts_{0};
+  std::chrono::milliseconds initial_backoff_{0};
+  std::chrono::milliseconds max_backoff_{0};
 };
 
 ROCKETMQ_NAMESPACE_END